@@ -28,13 +28,19 @@
 #pragma once
 
 #include <vq3Component.hpp>
+#include <vq3Coreset.hpp>
 #include <vq3Decorator.hpp>
 #include <vq3Epoch.hpp>
+#include <vq3Executor.hpp>
 #include <vq3Graph.hpp>
 #include <vq3GNGT.hpp>
 #include <vq3LBG.hpp>
+#include <vq3Locality.hpp>
 #include <vq3Online.hpp>
+#include <vq3Pipeline.hpp>
+#include <vq3Search.hpp>
 #include <vq3SOM.hpp>
+#include <vq3Sparse.hpp>
 #include <vq3Stats.hpp>
 #include <vq3Temporal.hpp>
 #include <vq3Topology.hpp>
@@ -206,9 +212,21 @@ auto topology = vq3::topology::table(g);
 ...
 topology(h, Emax, Hmin); // Both vertices and their neighborhoods are updated.
 auto ref_vertex   = topology(3);          // we get some vertex.
-neighborhood      = topology[3];          // Gets the precomputed neighborhood of the 4th vertex
-neighborhood      = topology[ref_vertex]; // Does the same.
+auto neighbors    = topology[3];          // Gets the precomputed neighborhood of the 4th vertex
+auto same         = topology[ref_vertex]; // Does the same.
+for(auto& info : neighbors) {             // This is a contiguous range of (index, value) pairs.
+    auto& ref_v = topology(info.index);
+    float coef  = info.value;
+}
    @endcode
+
+   For SOMs whose vertices are decorated with vq3::decorator::grid_pos,
+   vq3::topology::grid provides a table that generates the
+   neighborhoods on the fly from the grid positions (square, toroidal
+   or hexagonal grids), instead of storing them. For large graphs
+   where only a few vertices win the samples, topology.lazy(capacity,
+   h, Emax, Hmin) computes each neighborhood when it is first
+   accessed, and keeps it in a bounded cache.
    
    @subsection graphutils Utilities
 
@@ -331,6 +349,55 @@ using epoch_data   = epoch_data_1;
 some_processor p;
 p.process_something<epoch_data>(nb_threads, ...);
    @endcode
+
+   The number of threads can be replaced by an executor (see
+   vq3::concept::Executor). By default, each processing launches
+   its own threads. A vq3::executor::Pool keeps persistent threads
+   instead, which is worth it when the epochs are short.
+
+   @code
+auto pool = vq3::executor::pool(nb_threads); // The threads are created once.
+...
+p.process_something<epoch_data>(pool, ...);
+   @endcode
+
+   The samples are usually given by random access iterators, so that
+   the processors split them among the threads. Other iterators
+   (e.g. std::istream_iterator on a file that does not fit in memory)
+   are read once, by chunks that are handed to the threads (see
+   vq3::executor::stream).
+
+   @code
+std::ifstream file("samples.txt");
+p.process_something<epoch_data>(pool,
+				std::istream_iterator<sample>(file), std::istream_iterator<sample>(),
+				...);
+   @endcode
+
+   When the samples are acquired at each step (e.g. from a video
+   stream), a vq3::pipeline::Pipeline prepares the next batches in
+   other threads while the current one is learned.
+
+   @code
+auto pipeline = vq3::pipeline::pipeline<std::vector<sample>>(2); // double buffering.
+pipeline << [&](std::vector<sample>& S) {S.clear(); grab_samples(S);}
+         << [&](std::vector<sample>& S) {vq3::locality::hilbert(S.begin(), S.end(), coords_of);}; // Stages must not read the graph, it is being learned.
+while(auto S = pipeline.next()) // S is given back to the pipeline at the end of the loop.
+  p.process_something<epoch_data>(pool, S->begin(), S->end(), ...);
+   @endcode
+
+   The processors (and vq3::algo::lbg) also accept weighted samples,
+   through an extra weight_of argument. A weighted sample counts as
+   weight repeated samples. The functions in vq3::coreset compress
+   large sample sets, weighted or not, into few weighted samples (by merging the
+   samples of a grid cell, or by k-means++ seeding), so that the
+   epochs cost proportionally to the coreset size.
+
+   @code
+auto C = vq3::coreset::grid(S.begin(), S.end(), sample_of, coords_of, .01); // Samples are moved by at most .01*sqrt(dim).
+p.process_something<epoch_data>(pool, C.begin(), C.end(),
+				vq3::coreset::sample_of, vq3::coreset::weight_of, ...);
+   @endcode
    
    The purpose of the type stack is to customize the type epoch_data
    used by the processor. Each stack element (epoch_data_0,
@@ -388,7 +455,7 @@ bool topology_modified = processor.update_edges(nb_threads, S.begin(), S.end(),
 
    @subsubsection wta Winner-take-all processor
 
-   This processor applies a k-means update, i.e. each prototype is set to the centroid of its Voronoi cell.
+   This processor applies a k-means update, i.e. each prototype is set to the centroid of its Voronoi cell. The returned epoch data are stored in the processor, so that they are not allocated at each epoch. They are only valid until the next call of process.
    @code
 using sample       = ...;
 using vertex       = ...;
@@ -419,8 +486,8 @@ double dist(const prototype& p, const sample& s) {
 auto new_edge_value = edge(); // Value for initializing new edges.
 
 topology(); // Notifies the graph structure, redo it at each topology change.    
-auto epoch_result = processor.process<epoch_data>(nb_threads, S.begin(), S.end(),
-                                                  sample_of, prototype_of, dist);
+auto& epoch_result = processor.process<epoch_data>(nb_threads, S.begin(), S.end(),
+                                                   sample_of, prototype_of, dist);
 for(epoch_data& data : epoch_result) {
   // data is the epoch data computed for each vertex.
   std::cout << data.vq3_wta_accum.average<double>() << std::endl;
@@ -468,8 +535,8 @@ auto new_edge_value = edge(); // Value for initializing new edges.
 // a minimal threshold for considering a coefficient as non null.
 topology([](unsigned int edge_distance) {return std::max(0., 1 - edge_distance/5.0;},
          5, 1e-3));   
-auto epoch_result = processor.process<epoch_data>(nb_threads, S.begin(), S.end(),
-                                                  sample_of, prototype_of, dist);
+auto& epoch_result = processor.process<epoch_data>(nb_threads, S.begin(), S.end(),
+                                                   sample_of, prototype_of, dist);
 for(epoch_data& data : epoch_result) {
   // data is the epoch data computed for each vertex.
   std::cout << data.vq3_wtm_accum.average<double>() << std::endl;
@@ -477,6 +544,73 @@ for(epoch_data& data : epoch_result) {
 
   @endcode
 
+   @subsubsection wta_chl Fused winner-take-all and CHL processor
+
+   When a WTA pass and a CHL pass are run on the same samples, with
+   some vertices cloned or killed in between (as GNG-T does), the
+   vq3::epoch::wta_chl processor finds the two closest vertices of
+   each sample once. The CHL pass only compares the samples to the
+   new vertices, or rescans the graph for the samples whose closest
+   vertices have been killed. The prototypes of the remaining
+   vertices must not have moved.
+   @code
+auto processor     = vq3::epoch::wta_chl::processor(topology);
+auto& epoch_result = processor.process<epoch_data>(nb_threads, S.begin(), S.end(),
+                                                   sample_of, prototype_of, dist);
+// ... clone or kill some vertices according to epoch_result.
+topology();
+bool topology_modified = processor.update_edges(nb_threads, S.begin(), S.end(),
+						sample_of, dist, new_edge_value);
+   @endcode
+
+   @subsubsection minibatch Mini-batch processors
+
+   On large sample sets, the wta and wtm processors can be run on
+   random batches (see vq3::epoch::minibatch). Each batch moves the
+   prototypes toward the batch averages with a decreasing per-vertex
+   learning rate. The batches grow when the prototypes stop moving,
+   up to the whole set.
+   @code
+auto processor = vq3::epoch::minibatch::wta_processor(topology, 1000); // initial batch size.
+while(!processor.converged())
+  processor.process<epoch_data>(nb_threads, random_device, S.begin(), S.end(),
+				sample_of, prototype_of, dist,
+				[](const prototype& p1, const prototype& p2) {return d2(p1, p2) > 1e-6;}); // Still moving ?
+   @endcode
+
+   @subsubsection search Best matching unit search
+
+   The wta and wtm processors find the best matching unit of each
+   sample by scanning the graph with the distance function. A search
+   object (see vq3::concept::Search) can be passed instead of the
+   distance function in order to change that strategy. For example,
+   the following scans a float32 copy of the prototypes, and re-ranks
+   the two best candidates with the actual distance.
+   @code
+auto search = vq3::search::reduced::float32(dist,
+                                            [](const vertex& v) {return components_of(v.vq3_value);},
+                                            [](const sample& s) {return components_of(s);});
+auto& epoch_result = processor.process<epoch_data>(nb_threads, S.begin(), S.end(),
+                                                   sample_of, prototype_of, search);
+  @endcode
+
+  For large SOMs whose vertices are decorated with
+  vq3::decorator::grid_pos, vq3::search::grid::coarse_to_fine scans a
+  subsampled grid first, and then the neighbourhood of the coarse
+  winners only.
+
+  The samples are split into contiguous chunks (about eight per
+  thread), that the threads claim one after the other. The functions
+  in vq3::locality reorder the samples once (along a Morton or a
+  Hilbert curve, or according to their current BMU), so that the
+  samples of a chunk hit a few nearby vertices, whose prototypes,
+  neighborhoods and epoch data stay in the cache of the thread.
+
+  Each job accumulates its epoch data for every vertex, unless the
+  vertices far outnumber the ones it can touch (e.g. a large codebook
+  and few samples per job). The job then only stores the epoch data
+  of the touched vertices, and only these are merged.
+
   @section algo Amgorithms
 
   The algorithms provided by vq3 are based on the "processor"
@@ -0,0 +1,301 @@
+/*
+ *   Copyright (C) 2018,  CentraleSupelec
+ *
+ *   Author : Hervé Frezza-Buet
+ *
+ *   Contributor :
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public
+ *   License (GPL) as published by the Free Software Foundation; either
+ *   version 3 of the License, or any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *   General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *   Contact : herve.frezza-buet@centralesupelec.fr
+ *
+ */
+
+
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <random>
+#include <iterator>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include <vq3Utils.hpp>
+
+namespace vq3 {
+
+  /**
+   * A coreset is a small set of weighted samples that summarizes a
+   * large sample set. The processors and vq3::algo::lbg accept
+   * weighted samples (see their weight_of arguments), so an epoch on
+   * the coreset costs proportionally to its size rather than to the
+   * number of raw samples.
+   */
+  namespace coreset {
+
+    /**
+     * This is a weighted sample, representing weight samples of the
+     * original set.
+     */
+    template<typename SAMPLE>
+    struct Weighted {
+      SAMPLE sample;
+      double weight;
+    };
+
+    /** sample_of(weighted) is the sample, for the processors. */
+    struct SampleOf {
+      template<typename SAMPLE>
+      const SAMPLE& operator()(const Weighted<SAMPLE>& w) const {return w.sample;}
+    };
+
+    /** weight_of(weighted) is the weight, for the processors. */
+    struct WeightOf {
+      template<typename SAMPLE>
+      double operator()(const Weighted<SAMPLE>& w) const {return w.weight;}
+    };
+
+    inline constexpr SampleOf sample_of {};
+    inline constexpr WeightOf weight_of {};
+
+    namespace internal {
+
+      /** This is the weight_of function of the functions called without weights. */
+      struct unit_weight {};
+
+      template<typename WEIGHT_OF, typename VALUE>
+      double weight(const WEIGHT_OF& weight_of, const VALUE& value) {
+	if constexpr (std::is_same_v<WEIGHT_OF, unit_weight>)
+	  return 1;
+	else
+	  return weight_of(value);
+      }
+
+      /** This adds a sample of weight w to the accumulator, a unit weight keeps the plain sum. */
+      template<typename WEIGHT_OF, typename ACCUM, typename SAMPLE>
+      void add(ACCUM& accum, double w, const SAMPLE& sample) {
+	if constexpr (std::is_same_v<WEIGHT_OF, unit_weight>)
+	  accum += sample;
+	else
+	  accum.increment(w, sample);
+      }
+
+      /**
+       * This draws an index in [0, n[ with a probability proportional
+       * to value_of(index), total being the sum of the values.
+       */
+      template<typename RANDOM_ENGINE, typename VALUE_OF>
+      std::size_t draw(RANDOM_ENGINE& rd, std::size_t n, const VALUE_OF& value_of, double total) {
+	double      r    = std::uniform_real_distribution<double>(0, total)(rd);
+	std::size_t last = n - 1; // The last index with a positive value, in case of rounding errors.
+	for(std::size_t i = 0; i < n; ++i)
+	  if(double v = value_of(i); v > 0) {
+	    last = i;
+	    if((r -= v) < 0)
+	      return i;
+	  }
+	return last;
+      }
+
+      template<typename SAMPLE_OF, typename IT>
+      using average_type = std::decay_t<decltype(std::declval<utils::accum<std::decay_t<decltype(std::declval<const SAMPLE_OF&>()(*std::declval<IT>()))>, double>>().template average<double>())>;
+
+      struct CellHash {
+	std::size_t operator()(const std::vector<std::int64_t>& cell) const {
+	  std::uint64_t h = 0xcbf29ce484222325ULL;
+	  for(auto c : cell) {
+	    h ^= (std::uint64_t)c;
+	    h *= 0x100000001b3ULL;
+	  }
+	  return h;
+	}
+      };
+    }
+
+    /**
+     * This merges the samples that fall in the same cell of a regular
+     * grid. Each non-empty cell gives a weighted sample, located at
+     * the average of the cell samples. Each sample is thus at most at
+     * cell_size*sqrt(dim) (euclidean distance of the coordinates) from
+     * its representative. The samples are weighted (e.g. histogram
+     * bins, or a coreset): the representative of a cell is the
+     * weighted average of its samples, and its weight is the sum of
+     * theirs. The samples with a null weight are ignored.
+     * @param begin, end The samples, read once.
+     * @param sample_of sample_of(*it) returns the sample.
+     * @param weight_of weight_of(*it) is the weight of the sample.
+     * @param coords_of coords_of(sample) returns the (iterable) collection of the sample coordinates.
+     * @param cell_size The side of the cells.
+     * @return A vector of vq3::coreset::Weighted samples.
+     */
+    template<typename IT, typename SAMPLE_OF, typename WEIGHT_OF, typename COORDS_OF>
+    auto grid(const IT& begin, const IT& end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of, const COORDS_OF& coords_of, double cell_size) {
+      using sample_type = std::decay_t<decltype(sample_of(*begin))>;
+      using result_type = internal::average_type<SAMPLE_OF, IT>;
+
+      if(!(cell_size > 0))
+	throw std::runtime_error("vq3::coreset::grid : the cell size must be positive.");
+
+      std::unordered_map<std::vector<std::int64_t>, std::size_t, internal::CellHash> index_of_cell;
+      std::vector<utils::accum<sample_type, double>> cells;
+      std::vector<std::int64_t> cell;
+      for(auto it = begin; it != end; ++it) {
+	double w = internal::weight(weight_of, *it);
+	if(w <= 0)
+	  continue;
+	const auto& sample = sample_of(*it);
+	cell.clear();
+	for(double c : coords_of(sample))
+	  cell.push_back((std::int64_t)(std::floor(c / cell_size)));
+	auto [pos, inserted] = index_of_cell.try_emplace(cell, cells.size());
+	if(inserted)
+	  cells.emplace_back();
+	internal::add<WEIGHT_OF>(cells[pos->second], w, sample);
+      }
+
+      std::vector<Weighted<result_type>> res;
+      res.reserve(cells.size());
+      for(auto& c : cells)
+	res.push_back({c.template average<double>(), c.nb});
+      return res;
+    }
+
+    /**
+     * This is grid for samples of weight 1.
+     */
+    template<typename IT, typename SAMPLE_OF, typename COORDS_OF>
+    auto grid(const IT& begin, const IT& end, const SAMPLE_OF& sample_of, const COORDS_OF& coords_of, double cell_size) {
+      return grid(begin, end, sample_of, internal::unit_weight(), coords_of, cell_size);
+    }
+
+    /**
+     * This picks up to k centers by k-means++ seeding: each new center
+     * is drawn among the samples with a probability proportional to
+     * its distance to the closest center already chosen. Each sample
+     * is then assigned to its closest center, and each center gives a
+     * weighted sample located at the average of its samples. The
+     * seeding stops before k centers when every sample is at most at
+     * max_distance from a center. This costs O(nk) distance
+     * computations. The samples are weighted (e.g. histogram bins,
+     * or a coreset): the centers are drawn with a probability
+     * proportional to the weighted distances, and the representatives
+     * are the weighted averages. The samples with a null weight are
+     * ignored.
+     *
+     * The representatives are the averages, not the centers, so
+     * max_distance does not bound the distance of the samples to
+     * their representative. With the squared euclidean distance, an
+     * average lies in the ball of radius sqrt(max_distance) around its
+     * center, as its samples do, so the samples are at most at
+     * 4*max_distance from their representative.
+     * @param rd The random engine.
+     * @param begin, end The samples (random access iterators).
+     * @param sample_of sample_of(*it) returns the sample.
+     * @param weight_of weight_of(*it) is the weight of the sample.
+     * @param distance distance(sample, sample), typically the squared euclidean distance as k-means++ requires.
+     * @param k The maximal size of the coreset.
+     * @param max_distance The seeding stops when all the samples are at most at max_distance from a center.
+     * @return A vector of vq3::coreset::Weighted samples.
+     */
+    template<typename RANDOM_ENGINE, typename IT, typename SAMPLE_OF, typename WEIGHT_OF, typename DISTANCE,
+	     typename std::enable_if_t<!std::is_arithmetic_v<DISTANCE>, int> = 0> // Otherwise, kmeanspp(rd, begin, end, sample_of, distance, k, max_distance) is ambiguous.
+    auto kmeanspp(RANDOM_ENGINE& rd, const IT& begin, const IT& end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of, const DISTANCE& distance,
+		  std::size_t k, double max_distance = 0) {
+      using sample_type = std::decay_t<decltype(sample_of(*begin))>;
+      using result_type = internal::average_type<SAMPLE_OF, IT>;
+
+      std::size_t n = std::distance(begin, end);
+      std::vector<Weighted<result_type>> res;
+      if(n == 0 || k == 0)
+	return res;
+
+      std::vector<double> weights;
+      double              total_weight = 0;
+      weights.reserve(n);
+      for(auto it = begin; it != end; ++it) {
+	weights.push_back(std::max(internal::weight(weight_of, *it), 0.));
+	total_weight += weights.back();
+      }
+      if(!(total_weight > 0))
+	return res;
+
+      std::vector<double>      dist(n, std::numeric_limits<double>::max());
+      std::vector<std::size_t> center_of(n, 0);
+      std::vector<std::size_t> centers;
+
+      std::size_t next;
+      if constexpr (std::is_same_v<WEIGHT_OF, internal::unit_weight>)
+	next = std::uniform_int_distribution<std::size_t>(0, n - 1)(rd);
+      else
+	next = internal::draw(rd, n, [&weights](std::size_t i) {return weights[i];}, total_weight);
+      while(true) {
+	auto        c      = centers.size();
+	const auto& center = sample_of(*(begin + next));
+	centers.push_back(next);
+
+	double total = 0;
+	double worst = 0;
+	auto   dit   = dist.begin();
+	auto   cit   = center_of.begin();
+	auto   wit   = weights.begin();
+	for(auto it = begin; it != end; ++it, ++dit, ++cit, ++wit) {
+	  double d = distance(sample_of(*it), center);
+	  if(d < *dit) {
+	    *dit = d;
+	    *cit = c;
+	  }
+	  if(*wit > 0) {
+	    total += *wit * *dit;
+	    worst  = std::max(worst, *dit);
+	  }
+	}
+
+	if(centers.size() == k || worst <= max_distance || !(total > 0))
+	  break;
+
+	next = internal::draw(rd, n, [&weights, &dist](std::size_t i) {return weights[i] * dist[i];}, total);
+      }
+
+      std::vector<utils::accum<sample_type, double>> cells(centers.size());
+      auto cit = center_of.begin();
+      auto wit = weights.begin();
+      for(auto it = begin; it != end; ++it, ++cit, ++wit)
+	if(*wit > 0)
+	  internal::add<WEIGHT_OF>(cells[*cit], *wit, sample_of(*it));
+
+      res.reserve(cells.size());
+      for(auto& c : cells)
+	if(c.nb != 0)
+	  res.push_back({c.template average<double>(), c.nb});
+      return res;
+    }
+
+    /**
+     * This is kmeanspp for samples of weight 1.
+     */
+    template<typename RANDOM_ENGINE, typename IT, typename SAMPLE_OF, typename DISTANCE>
+    auto kmeanspp(RANDOM_ENGINE& rd, const IT& begin, const IT& end, const SAMPLE_OF& sample_of, const DISTANCE& distance,
+		  std::size_t k, double max_distance = 0) {
+      return kmeanspp(rd, begin, end, sample_of, internal::unit_weight(), distance, k, max_distance);
+    }
+  }
+}
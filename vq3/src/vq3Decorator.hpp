@@ -31,6 +31,7 @@
 
 #include <iostream>
 #include <type_traits>
+#include <cstddef>
 
 namespace vq3 {
   namespace decorator {
@@ -567,6 +568,50 @@ namespace vq3 {
     
       template<typename MOTHER, typename VALUE, typename ONLINE_PARAM>
       using mean_std = MeanStd<MOTHER, VALUE, ONLINE_PARAM, typename vq3::decorator::decoration<MOTHER>::value_type>;
+
+
+      /* ####################### */
+      /* #                     # */
+      /* # Covariance (online) # */
+      /* #                     # */
+      /* ####################### */
+
+      template<typename MOTHER, std::size_t DIM, typename ONLINE_PARAM, typename KIND> 
+      struct Covariance : public MOTHER {
+	using decorated_type = typename MOTHER::decorated_type;
+	vq3::stats::online::Covariance<DIM, ONLINE_PARAM> vq3_online_covariance;
+	Covariance(const decorated_type& val) : MOTHER(val), vq3_online_covariance() {}
+	Covariance& operator=(const decorated_type& val) {this->vq3_value = val; return *this;}
+      };
+    
+      // When we decorate a non decorated value.
+      template<typename MOTHER, std::size_t DIM, typename ONLINE_PARAM> 
+      struct Covariance<MOTHER, DIM, ONLINE_PARAM, vq3::decorator::not_decorated> {
+	using decorated_type = MOTHER;
+	MOTHER vq3_value;
+	vq3::stats::online::Covariance<DIM, ONLINE_PARAM> vq3_online_covariance;
+	Covariance(const decorated_type& val) : vq3_value(val), vq3_online_covariance() {}
+	Covariance& operator=(const decorated_type& val) {vq3_value = val; return *this;}
+      };
+    
+      // When we decorate a decorated type with no value.
+      template<typename MOTHER, std::size_t DIM, typename ONLINE_PARAM> 
+      struct Covariance<MOTHER, DIM, ONLINE_PARAM, vq3::decorator::unvalued_decoration> : public MOTHER {
+	using decorated_type = MOTHER;
+	vq3::stats::online::Covariance<DIM, ONLINE_PARAM> vq3_online_covariance;
+	Covariance() : MOTHER(), vq3_online_covariance() {}
+      };
+    
+      // When we decorate void.
+      template<std::size_t DIM, typename ONLINE_PARAM> 
+      struct Covariance<void, DIM, ONLINE_PARAM, vq3::decorator::not_decorated> {
+	using decorated_type = void;
+	vq3::stats::online::Covariance<DIM, ONLINE_PARAM> vq3_online_covariance;
+	Covariance() : vq3_online_covariance() {}
+      };
+    
+      template<typename MOTHER, std::size_t DIM, typename ONLINE_PARAM>
+      using covariance = Covariance<MOTHER, DIM, ONLINE_PARAM, typename vq3::decorator::decoration<MOTHER>::value_type>;
     }
   }
 }
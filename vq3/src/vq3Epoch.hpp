@@ -35,9 +35,17 @@
 #include <map>
 #include <utility>
 #include <iterator>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <cstdint>
+#include <type_traits>
+#include <random>
 
 #include <vq3Topology.hpp>
+#include <vq3Search.hpp>
 #include <vq3Utils.hpp>
+#include <vq3Executor.hpp>
 
 namespace vq3 {
   
@@ -62,10 +70,15 @@ namespace vq3 {
        */
       void notify_closest(const sample_type& sample, double closest_distance);
 
+      /**
+       * This is notify_closest for a weighted sample, as if the sample were repeated weight times. It is only required when the processors are given a weight_of function.
+       */
+      void notify_closest(const sample_type& sample, double closest_distance, double weight);
+
       /**
        * This notifies that the prototype should be updated.
        * @param sample The current sample that is submitted.
-       * @param topo_coef This is the WTM coefficient related to edge-distance between the BMU and the prototype.
+       * @param topo_coef This is the WTM coefficient related to edge-distance between the BMU and the prototype. It is multiplied by the sample weight for weighted samples.
        */
       void notify_wtm_update(const sample_type& sample, double topo_coef);
 
@@ -76,13 +89,18 @@ namespace vq3 {
       void notify_wta_update(const sample_type& sample);
 
       /**
-       * This is learning, at the end of an epoch.
+       * This is notify_wta_update for a weighted sample. It is only required when the processors are given a weight_of function.
+       */
+      void notify_wta_update(const sample_type& sample, double weight);
+
+      /**
+       * This is learning, at the end of an epoch. It may be called concurrently for distinct vertices.
        * @prototype This is the prototype of the vertex, passed by reference in order do be modified by the call.
        */
       void set_prototype(prototype_type& prototype);
 
       /**
-       * This is prototype value updating, at the end of an epoch (i.e. not in the parallel execution).
+       * This is prototype value updating, at the end of an epoch, once the epoch data of all the jobs have been merged. It may be called concurrently for distinct vertices.
        * @vertex_value This is the vertex value of the vertex, passed by reference in order do be modified by the call.
        */
       void set_content(vertex_value_type& vertex_value);
@@ -96,6 +114,274 @@ namespace vq3 {
   
   namespace epoch {
 
+    namespace internal {
+
+      /** This is the weight_of function of the processors called without weights. */
+      struct unit_weight {};
+      
+      template<typename WEIGHT_OF>
+      constexpr bool is_weighted = !std::is_same_v<WEIGHT_OF, unit_weight>;
+      
+      using FlatMap = vq3::utils::FlatMap;
+
+      /** This is the epoch data buffer of a job. */
+      template<typename EPOCH_DATA>
+      using buffer = std::vector<EPOCH_DATA, vq3::executor::CacheAligned<EPOCH_DATA>>;
+
+      /**
+       * This is the epoch data buffer of a job that only touches a few
+       * vertices. It only stores an epoch data for these vertices,
+       * found from their index with a hash table. Resetting keeps the
+       * memory.
+       */
+      template<typename EPOCH_DATA>
+      class sparse_buffer {
+      private:
+
+	const EPOCH_DATA         blank {};
+	FlatMap                  slot_of;  // The keys are the vertex indices.
+	std::vector<std::size_t> indices;  // indices[slot] is the vertex index of data[slot].
+	buffer<EPOCH_DATA>       data;
+	std::size_t              nb = 0;   // The number of slots in use.
+
+      public:
+
+	sparse_buffer() : slot_of(), indices(), data(), nb(0) {}
+
+	void reset() {
+	  slot_of.clear();
+	  nb = 0;
+	}
+
+	/** @return The epoch data of the vertex idx, it is a default one if the vertex has not been touched yet. */
+	EPOCH_DATA& operator[](std::size_t idx) {
+	  if(auto slot = slot_of.find(idx); slot)
+	    return data[*slot];
+	  slot_of.insert(idx, (std::uint32_t)nb);
+	  if(nb == data.size()) {
+	    indices.push_back(idx);
+	    data.push_back(blank);
+	  }
+	  else {
+	    indices[nb] = idx;
+	    data[nb]    = blank;
+	  }
+	  return data[nb++];
+	}
+
+	/** This calls fun(idx, epoch_data) for the touched vertices. */
+	template<typename FUN>
+	void foreach(const FUN& fun) const {
+	  auto iit = indices.begin();
+	  auto end = data.begin() + nb;
+	  for(auto it = data.begin(); it != end; ++it)
+	    fun(*(iit++), *it);
+	}
+      };
+
+      /**
+       * A job is given a sparse buffer when the number of vertices is
+       * more than sparse_ratio times the number of vertices it is
+       * expected to touch.
+       */
+      inline constexpr std::size_t sparse_ratio = 4;
+
+      /**
+       * These are the epoch data buffers of the jobs. In dense mode,
+       * each job has an epoch data for each vertex, and the buffers
+       * are merged into the result, which is the buffer of the first
+       * job. In sparse mode, each job has a sparse buffer, and they
+       * are merged into the result. The result is kept from one
+       * processing to the next, so that its memory is reused.
+       */
+      template<typename EPOCH_DATA>
+      struct buffers {
+	std::vector<EPOCH_DATA>                                                result;    // The merged epoch data, for each vertex index.
+	vq3::executor::Workspace<buffer<EPOCH_DATA>>                           dense;     // dense[job - 1] is the buffer of the job, for job > 0.
+	vq3::executor::Workspace<sparse_buffer<EPOCH_DATA>>                    sparse;
+	std::vector<std::vector<std::pair<std::size_t, const EPOCH_DATA*>>> buckets;   // buckets[range] are the sparse epoch data of the vertices of the merged range.
+	bool                                                                   is_sparse = false;
+      };
+
+      /**
+       * @return The number of vertices a job is expected to touch, when
+       * each sample touches touched_per_sample vertices, or 0 if it
+       * is unknown (the samples are streamed).
+       */
+      template<typename ITERATOR>
+      std::size_t touched_per_job(const ITERATOR& begin, const ITERATOR& end, std::size_t nb_jobs, std::size_t touched_per_sample) {
+	if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<ITERATOR>::iterator_category>)
+	  return ((std::distance(begin, end) / std::max(nb_jobs, (std::size_t)1)) + 1) * touched_per_sample;
+	else
+	  return 0;
+      }
+
+      /**
+       * This gets the buffers of nb_jobs jobs from the workspace. The
+       * sparse mode is used when several jobs touch few vertices
+       * each (see touched_per_job and sparse_ratio). The epoch data
+       * kept from the previous processing are reset by a copy of a
+       * default one, which keeps their allocated memory. In sparse
+       * mode, the result is reset by merge_and_set instead.
+       */
+      template<typename EPOCH_DATA>
+      auto& prepare_workspace(vq3::executor::AnyWorkspace& any, std::size_t nb_jobs, std::size_t nb_vertices, std::size_t touched_per_job) {
+	auto& workspace = any.template get<buffers<EPOCH_DATA>>();
+	const EPOCH_DATA blank {};
+	auto reset_dense = [nb_vertices, &blank](auto& data) {
+	  auto kept = data.begin() + std::min(data.size(), nb_vertices);
+	  for(auto it = data.begin(); it != kept; ++it)
+	    *it = blank;
+	  data.resize(nb_vertices);
+	};
+	
+	workspace.is_sparse = nb_jobs > 1 && touched_per_job != 0 && sparse_ratio * touched_per_job < nb_vertices;
+	if(workspace.is_sparse) {
+	  workspace.result.resize(nb_vertices);
+	  for(std::size_t job = 0; job < workspace.dense.size(); ++job)
+	    buffer<EPOCH_DATA>().swap(workspace.dense[job]); // The memory of the dense mode is released.
+	  workspace.sparse.prepare(nb_jobs, [](sparse_buffer<EPOCH_DATA>& data) {data.reset();});
+	}
+	else {
+	  reset_dense(workspace.result);
+	  if(nb_jobs > 1)
+	    workspace.dense.prepare(nb_jobs - 1, reset_dense);
+	}
+	return workspace;
+      }
+
+      /**
+       * This calls run(job_process), job_process(job, it) calling
+       * process(job, data, it) with data being the buffer of the job,
+       * either dense or sparse. Both give the epoch data of the vertex
+       * idx by data[idx].
+       */
+      template<typename EPOCH_DATA, typename PROCESS, typename RUN>
+      void with_buffers(buffers<EPOCH_DATA>& workspace, const PROCESS& process, const RUN& run) {
+	if(workspace.is_sparse)
+	  run([&workspace, &process](unsigned int job, const auto& it) {process(job, workspace.sparse[job], it);});
+	else
+	  run([&workspace, &process](unsigned int job, const auto& it) {
+	      if(job == 0)
+		process(job, workspace.result, it);
+	      else
+		process(job, workspace.dense[job - 1], it);
+	    });
+      }
+
+      /**
+       * This runs process(job, data, it) for each sample (see
+       * with_buffers). Single-pass ranges are streamed, so it may
+       * receive iterators on the stream chunks (see
+       * vq3::executor::for_each).
+       */
+      template<typename EXECUTOR, typename EPOCH_DATA, typename ITERATOR, typename PROCESS>
+      void for_each(EXECUTOR& executor, buffers<EPOCH_DATA>& workspace, const ITERATOR& begin, const ITERATOR& end, const PROCESS& process) {
+	auto job_of = [](unsigned int job) {return job;};
+	with_buffers(workspace, process, [&executor, &begin, &end, &job_of](const auto& job_process) {
+	    vq3::executor::for_each(executor, begin, end, job_of, job_process);
+	  });
+      }
+
+      /**
+       * This is for_each for multi-pass ranges, they are never
+       * streamed, so that process always receives iterators of the
+       * range (see vq3::executor::dispatch).
+       */
+      template<typename EXECUTOR, typename EPOCH_DATA, typename ITERATOR, typename PROCESS>
+      void dispatch(EXECUTOR& executor, buffers<EPOCH_DATA>& workspace, const ITERATOR& begin, const ITERATOR& end, const PROCESS& process) {
+	auto job_of = [](unsigned int job) {return job;};
+	with_buffers(workspace, process, [&executor, &begin, &end, &job_of](const auto& job_process) {
+	    auto futures = vq3::executor::dispatch(executor, begin, end, job_of, job_process);
+	    vq3::executor::wait(futures);
+	  });
+      }
+
+      /**
+       * This merges the epoch data computed by the jobs (the
+       * workspace buffers), and then sets the prototypes and the
+       * vertex contents. Both are done in parallel, each job handling
+       * a contiguous range of vertex indices, so set_prototype and
+       * set_content are called concurrently for distinct vertices. In
+       * sparse mode, only the touched epoch data are merged: they are
+       * first dispatched to the ranges, and each range resets its
+       * part of the result before adding them.
+       * @return The merged epoch data (the workspace result).
+       */
+      template<typename EXECUTOR, typename TABLE, typename EPOCH_DATA, typename PROTOTYPE_OF_VERTEX_VALUE>
+      std::vector<EPOCH_DATA>& merge_and_set(EXECUTOR& executor, TABLE& table, buffers<EPOCH_DATA>& workspace,
+					     const PROTOTYPE_OF_VERTEX_VALUE& prototype_of) {
+	auto nb_jobs = executor.size();
+	if(nb_jobs == 0) {
+	  workspace.result.clear();
+	  return workspace.result;
+	}
+
+	auto& data0      = workspace.result;
+	auto nb_vertices = data0.size();
+	std::vector<std::size_t> ends; // ends[range] is the end of the range of vertex indices handled by a job.
+	if(nb_jobs <= 1 || nb_vertices < 2*nb_jobs)
+	  ends.push_back(nb_vertices);
+	else
+	  for(auto& begin_end : utils::split(data0.begin(), data0.end(), nb_jobs))
+	    ends.push_back(std::distance(data0.begin(), begin_end.second));
+
+	if(workspace.is_sparse) {
+	  auto& buckets = workspace.buckets;
+	  buckets.resize(ends.size());
+	  for(auto& bucket : buckets)
+	    bucket.clear();
+	  for(unsigned int job = 0; job < nb_jobs; ++job)
+	    workspace.sparse[job].foreach([&buckets, &ends](std::size_t idx, const EPOCH_DATA& data) {
+		buckets[std::distance(ends.begin(), std::upper_bound(ends.begin(), ends.end(), idx))].emplace_back(idx, &data);
+	      });
+	}
+
+	const EPOCH_DATA blank {};
+	auto merge_and_set_range = [&workspace, nb_jobs, &table, &prototype_of, &blank](std::size_t range, std::size_t begin, std::size_t end) {
+	  auto b0 = workspace.result.begin() + begin;
+	  auto e0 = workspace.result.begin() + end;
+	  if(workspace.is_sparse) {
+	    for(auto b = b0; b != e0; ++b)
+	      *b = blank; // The reset is done along with the setting, which visits all the vertices anyway.
+	    for(auto& idx_data : workspace.buckets[range])
+	      workspace.result[idx_data.first] += *(idx_data.second);
+	  }
+	  else
+	    for(unsigned int job = 1; job < nb_jobs; ++job) {
+	      auto bi = workspace.dense[job - 1].begin() + begin;
+	      for(auto b = b0; b != e0; ++b, ++bi)
+		(*b) += *bi;
+	    }
+	  
+	  std::size_t idx = begin;
+	  for(auto b = b0; b != e0; ++b) {
+	    auto& value = (*(table(idx++)))();
+	    b->set_prototype(prototype_of(value));
+	    b->set_content(value);
+	  }
+	};
+
+	if(ends.size() == 1)
+	  merge_and_set_range(0, 0, nb_vertices);
+	else {
+	  // The calling thread handles the first range.
+	  std::vector<std::future<void>> jobs;
+	  for(std::size_t range = 1; range < ends.size(); ++range)
+	    jobs.push_back(executor.async([&merge_and_set_range, &ends, range]() {merge_and_set_range(range, ends[range - 1], ends[range]);}));
+	  try {
+	    merge_and_set_range(0, 0, ends[0]);
+	  }
+	  catch(...) {
+	    for(auto& j : jobs) j.wait(); // The jobs use local variables.
+	    throw;
+	  }
+	  vq3::executor::wait(jobs);
+	}
+	return data0;
+      }
+    }
+
     /**
      * Computes the distortion for several epoch data. The epoch data given by iterators may implement the vq3::epoch::data::bmu behavior.
      */
@@ -126,11 +412,17 @@ namespace vq3 {
 	void  notify_closest    (const sample_type&, double) {}
 	//!< nop. 
 	
+	void  notify_closest    (const sample_type&, double, double) {}
+	//!< nop. 
+	
 	void  notify_wtm_update (const sample_type&, double) {}
 	//!< nop. 
 	
 	void  notify_wta_update (const sample_type&)         {}
 	//!< nop.
+	
+	void  notify_wta_update (const sample_type&, double) {}
+	//!< nop.
 
 	void set_prototype(prototype_type& prototype) {}
 	//!< nop.
@@ -160,6 +452,11 @@ namespace vq3 {
 	}
 	//!< nop. 
 	
+	void notify_closest(const sample_type& sample, double dist, double weight) {
+	  this->MOTHER::notify_closest(sample, dist, weight);
+	}
+	//!< nop. 
+	
 	void notify_wtm_update(const sample_type& sample, double coef) {
 	  this->MOTHER::notify_wtm_update(sample, coef);
 	}
@@ -170,6 +467,12 @@ namespace vq3 {
 	  vq3_wta_accum += sample;
 	}
 	//!< accum += sample
+	
+	void notify_wta_update(const sample_type& sample, double weight) {
+	  this->MOTHER::notify_wta_update(sample, weight);
+	  vq3_wta_accum.increment(weight, sample);
+	}
+	//!< accum += weight * sample
 
 	void set_prototype(prototype_type& prototype) {
 	  this->MOTHER::set_prototype(prototype);
@@ -210,6 +513,11 @@ namespace vq3 {
 	}
 	//!< nop. 
 	
+	void notify_closest(const sample_type& sample, double dist, double weight) {
+	  this->MOTHER::notify_closest(sample, dist, weight);
+	}
+	//!< nop. 
+	
 	
 	void notify_wtm_update(const sample_type& sample, double coef) {
 	  this->MOTHER::notify_wtm_update(sample, coef);
@@ -222,6 +530,11 @@ namespace vq3 {
 	  this->MOTHER::notify_wta_update(sample);
 	}
 	//!< nop. 
+	
+	void notify_wta_update(const sample_type& sample, double weight) {
+	  this->MOTHER::notify_wta_update(sample, weight);
+	}
+	//!< nop. 
 
 	void set_prototype(prototype_type& prototype) {
 	  this->MOTHER::set_prototype(prototype);
@@ -262,6 +575,12 @@ namespace vq3 {
 	}
 	//!< acum += distance;
 	
+	void notify_closest(const sample_type& sample, double dist, double weight) {
+	  this->MOTHER::notify_closest(sample, dist, weight);
+	  vq3_bmu_accum.increment(weight, dist);
+	}
+	//!< acum += weight * distance;
+	
 	void notify_wtm_update(const sample_type& sample, double coef) {
 	  this->MOTHER::notify_wtm_update(sample, coef);
 	}
@@ -271,6 +590,11 @@ namespace vq3 {
 	  this->MOTHER::notify_wta_update(sample);
 	}
 	//!< nop. 
+	
+	void notify_wta_update(const sample_type& sample, double weight) {
+	  this->MOTHER::notify_wta_update(sample, weight);
+	}
+	//!< nop. 
 
 	void set_prototype(prototype_type& prototype) {
 	  this->MOTHER::set_prototype(prototype);
@@ -311,6 +635,11 @@ namespace vq3 {
 	}
 	//!< nop. 
 	
+	void notify_closest(const sample_type& sample, double dist, double weight) {
+	  this->MOTHER::notify_closest(sample, dist, weight);
+	}
+	//!< nop. 
+	
 	void notify_wtm_update(const sample_type& sample, double coef) {
 	  this->MOTHER::notify_wtm_update(sample, coef);
 	}
@@ -321,6 +650,11 @@ namespace vq3 {
 	}
 	//!< accum += sample
 	
+	void notify_wta_update(const sample_type& sample, double weight) {
+	  this->MOTHER::notify_wta_update(sample, weight);
+	}
+	//!< nop. 
+	
 	void set_prototype(prototype_type& prototype) {
 	  vq3_previous_prototype = prototype;
 	  this->MOTHER::set_prototype(prototype);
@@ -364,6 +698,12 @@ namespace vq3 {
 	  }
 	  //!< acum += distance;
 	
+	  void notify_closest(const sample_type& sample, double dist, double weight) {
+	    this->MOTHER::notify_closest(sample, dist, weight);
+	    vq3_bmu_accum.increment(weight, dist);
+	  }
+	  //!< acum += weight * distance;
+	
 	  void notify_wtm_update(const sample_type& sample, double coef) {
 	    this->MOTHER::notify_wtm_update(sample, coef);
 	  }
@@ -373,6 +713,11 @@ namespace vq3 {
 	    this->MOTHER::notify_wta_update(sample);
 	  }
 	  //!< nop. 
+	
+	  void notify_wta_update(const sample_type& sample, double weight) {
+	    this->MOTHER::notify_wta_update(sample, weight);
+	  }
+	  //!< nop. 
 
 	  void set_prototype(prototype_type& prototype) {
 	    this->MOTHER::set_prototype(prototype);
@@ -391,140 +736,399 @@ namespace vq3 {
 	    return *this;
 	  }
 	};
+
+	/**
+	 * This computes the covariance of the samples in the Voronoï
+	 * cell of each vertex. It supposes that the vertex value has a
+	 * vq3_online_covariance attribute (see
+	 * vq3::decorator::online::covariance), that is updated with that
+	 * covariance at the end of the epoch. This is when the Cholesky
+	 * factorization used by vq3::search::mahalanobis is refreshed.
+	 *
+	 * COMPONENTS is a default constructible type such as
+	 * COMPONENTS()(sample) is the std::array<double, DIM> of the
+	 * sample components.
+	 */ 
+	template<typename MOTHER, typename COMPONENTS>
+	struct covariance : MOTHER {
+	  using sample_type = typename MOTHER::sample_type;
+	  using vertex_value_type = typename MOTHER::vertex_value_type;
+	  using prototype_type = typename MOTHER::prototype_type;
+
+	  using covariance_type = std::decay_t<decltype(std::declval<vertex_value_type&>().vq3_online_covariance)>;
+	  using vector_type     = typename covariance_type::vector_type;
+	  using matrix_type     = typename covariance_type::matrix_type;
+	  static constexpr std::size_t dim = covariance_type::dim;
+	
+	  double      vq3_cov_nb;      //!< The number of samples in the Voronoï cell (the sum of their weights).
+	  std::size_t vq3_cov_samples; //!< The number of distinct samples in the Voronoï cell, whatever their weights.
+	  vector_type vq3_cov_mean;    //!< The mean of the samples in the Voronoï cell.
+	  matrix_type vq3_cov_m2;      //!< The sum of the (x-mean).(x-mean)^T.
+
+	  covariance() : MOTHER(), vq3_cov_nb(0), vq3_cov_samples(0) {
+	    vq3_cov_mean.fill(0);
+	    vq3_cov_m2.fill(0);
+	  }
+
+	  void notify_closest(const sample_type& sample, double dist) {
+	    this->MOTHER::notify_closest(sample, dist);
+	    cov_update(sample, 1);
+	  }
+	  //!< Welford's update of the mean and the covariance.
+	
+	  void notify_closest(const sample_type& sample, double dist, double weight) {
+	    this->MOTHER::notify_closest(sample, dist, weight);
+	    cov_update(sample, weight);
+	  }
+	  //!< Weighted Welford's update of the mean and the covariance.
+
+	  void cov_update(const sample_type& sample, double weight) {
+	    if(weight <= 0)
+	      return;
+	    auto x = COMPONENTS()(sample);
+	    vector_type delta;
+	    vq3_cov_nb += weight;
+	    ++vq3_cov_samples;
+	    for(std::size_t i = 0; i < dim; ++i) {
+	      delta[i]         = x[i] - vq3_cov_mean[i];
+	      vq3_cov_mean[i] += delta[i]*weight/vq3_cov_nb;
+	    }
+	    auto m2 = vq3_cov_m2.begin();
+	    for(std::size_t i = 0; i < dim; ++i)
+	      for(std::size_t j = 0; j < dim; ++j)
+		*(m2++) += weight*delta[i]*(x[j] - vq3_cov_mean[j]);
+	  }
+	  //!< This adds a sample to the Voronoï cell statistics.
+	
+	  void notify_wtm_update(const sample_type& sample, double coef) {
+	    this->MOTHER::notify_wtm_update(sample, coef);
+	  }
+	  //!< nop. 
+	
+	  void notify_wta_update(const sample_type& sample) {
+	    this->MOTHER::notify_wta_update(sample);
+	  }
+	  //!< nop. 
+	
+	  void notify_wta_update(const sample_type& sample, double weight) {
+	    this->MOTHER::notify_wta_update(sample, weight);
+	  }
+	  //!< nop. 
+
+	  void set_prototype(prototype_type& prototype) {
+	    this->MOTHER::set_prototype(prototype);
+	  }
+	  //!< nop.
+
+	  void set_content(vertex_value_type& vertex_value) {
+	    this->MOTHER::set_content(vertex_value);
+	    double trace = 0;
+	    for(std::size_t i = 0; i < dim; ++i)
+	      trace += vq3_cov_m2[i*dim + i];
+	    if(vq3_cov_samples > 1 && trace > 0) { // A single (even heavy) sample, or identical ones, give no covariance.
+	      matrix_type c;
+	      auto m2 = vq3_cov_m2.begin();
+	      for(auto& cc : c) cc = *(m2++)/vq3_cov_nb;
+	      vertex_value.vq3_online_covariance += c;
+	    }
+	  }
+	  //!< vertex_value.vq3_online_covariance += covariance
+
+	  covariance<MOTHER, COMPONENTS>& operator+=(const covariance<MOTHER, COMPONENTS>& arg) {
+	    this->MOTHER::operator+=(arg);
+	    if(arg.vq3_cov_nb == 0)
+	      return *this;
+	    double nb = vq3_cov_nb + arg.vq3_cov_nb;
+	    double k  = vq3_cov_nb*arg.vq3_cov_nb/nb;
+	    vector_type delta;
+	    for(std::size_t i = 0; i < dim; ++i) {
+	      delta[i]         = arg.vq3_cov_mean[i] - vq3_cov_mean[i];
+	      vq3_cov_mean[i] += delta[i]*arg.vq3_cov_nb/nb;
+	    }
+	    auto m2  = vq3_cov_m2.begin();
+	    auto am2 = arg.vq3_cov_m2.begin();
+	    for(std::size_t i = 0; i < dim; ++i)
+	      for(std::size_t j = 0; j < dim; ++j)
+		*(m2++) += *(am2++) + delta[i]*delta[j]*k;
+	    vq3_cov_nb       = nb;
+	    vq3_cov_samples += arg.vq3_cov_samples;
+	    return *this;
+	  }
+	};
       }
     }
 
     namespace chl {
-      template<typename GRAPH>
-      class Processor {
-      private:
 
-	using graph_type = GRAPH;
-	using ref_vertex = typename graph_type::ref_vertex;
-	using ref_edge   = typename graph_type::ref_edge;
-	using edge       = typename graph_type::edge_value_type;
-      
-	graph_type& g;
+      namespace internal {
 
-	struct refpair {
-	  ref_vertex first, second;
-	  refpair()                          = default;
-	  refpair(const refpair&)            = default;
-	  refpair& operator=(const refpair&) = default;
-	  refpair(refpair&&)                 = default;
-	  refpair& operator=(refpair&&)      = default;
-	  
-	  refpair(const std::pair<ref_vertex, ref_vertex>& p)
-	    : first(p.first), second(p.second) {
-	    if(second < first)
-	      std::swap(first, second);
+	using FlatMap = vq3::epoch::internal::FlatMap;
+
+	/** @return The key of the pair of vertex indices {i, j}. */
+	inline std::uint64_t pair_key(std::uint32_t i, std::uint32_t j) {
+	  if(j < i)
+	    std::swap(i, j);
+	  return (std::uint64_t(i) << 32) | j;
+	}
+
+	/**
+	 * This indexes the vertices and the edges of the graph, before
+	 * a parallel computation.
+	 */
+	template<typename GRAPH>
+	struct Edges {
+	  std::vector<typename GRAPH::ref_vertex> vertices;
+	  std::vector<typename GRAPH::ref_edge>   edges;
+	  FlatMap                                 index_of_vertex; // The keys are the vertex addresses.
+	  FlatMap                                 index_of_edge;   // The keys are the pair_key of the extremities.
+
+	  /**
+	   * The vertices have to be set before.
+	   */
+	  void index(GRAPH& g) {
+	    if(vertices.size() >= std::numeric_limits<std::uint32_t>::max())
+	      throw std::runtime_error("vq3::epoch::chl : too many vertices.");
+	    index_of_vertex.clear();
+	    index_of_vertex.reserve(vertices.size());
+	    std::uint32_t idx = 0;
+	    for(auto& ref_v : vertices)
+	      index_of_vertex.insert(reinterpret_cast<std::uintptr_t>(ref_v.get()), idx++);
+
+	    edges.clear();
+	    index_of_edge.clear();
+	    g.foreach_edge([this](const typename GRAPH::ref_edge& ref_e) {
+		auto extr_pair = ref_e->extremities();
+		if(vq3::invalid_extremities(extr_pair)) {
+		  ref_e->kill();
+		  return;
+		}
+		auto i = index_of_vertex.find(reinterpret_cast<std::uintptr_t>(extr_pair.first.get()));
+		auto j = index_of_vertex.find(reinterpret_cast<std::uintptr_t>(extr_pair.second.get()));
+		if(i == nullptr || j == nullptr)
+		  throw std::runtime_error("vq3::epoch::chl : an edge links an unknown vertex.");
+		if(edges.size() >= std::numeric_limits<std::uint32_t>::max())
+		  throw std::runtime_error("vq3::epoch::chl : too many edges.");
+		if(index_of_edge.insert(pair_key(*i, *j), edges.size()))
+		  edges.push_back(ref_e);
+		else
+		  ref_e->kill(); // This is a duplicate, CHL would not have kept it.
+	      });
 	  }
 
-	  bool operator<(const refpair& other) const {
-	    return (first < other.first) || ((first == other.first) && (second < other.second));
+	  /**
+	   * This releases the references to the graph elements.
+	   */
+	  void release() {
+	    vertices.clear();
+	    edges.clear();
 	  }
 	};
 
+	/**
+	 * These are the edges collected by a job. The edges of the
+	 * graph that survive are flagged in a bitset, indexed by the
+	 * edges indices, and the new edges are stored as pairs of
+	 * vertex indices.
+	 */
 	struct data {
-	  std::set<ref_edge> survivors;
-	  std::set<refpair>  newedges;
+	  std::vector<std::uint64_t> survivors;
+	  FlatMap                    newedges;
 	  data()                       = default;
 	  data(const data&)            = default;
 	  data& operator=(const data&) = default;
 	  data(data&&)                 = default;
 	  data& operator=(data&&)      = default;
+
+	  void clear(std::size_t nb_edges) {
+	    survivors.assign((nb_edges + 63) / 64, 0);
+	    newedges.clear();
+	  }
+
+	  /**
+	   * This notifies that the vertices of indices i and j are the two closest ones for some sample.
+	   */
+	  template<typename GRAPH>
+	  void notify(const Edges<GRAPH>& edges, std::uint32_t i, std::uint32_t j) {
+	    auto key = pair_key(i, j);
+	    if(auto e = edges.index_of_edge.find(key); e != nullptr)
+	      survivors[*e / 64] |= std::uint64_t(1) << (*e % 64);
+	    else
+	      newedges.insert(key, 0);
+	  }
 	};
+
+	/**
+	 * This finds the indices of the two closest vertices.
+	 * @return false if there are less than two vertices.
+	 */
+	template<typename VERTICES, typename SAMPLE, typename DISTANCE>
+	bool two_closest(const VERTICES& vertices, const SAMPLE& sample, const DISTANCE& distance, std::uint32_t& first, std::uint32_t& second) {
+	  double dist1 = std::numeric_limits<double>::max();
+	  double dist2 = std::numeric_limits<double>::max();
+	  std::uint32_t idx = 0;
+	  std::size_t   nb  = 0;
+	  first = second = 0;
+	  for(auto& ref_v : vertices) {
+	    double d = distance((*ref_v)(), sample);
+	    if(d < dist1) {
+	      dist2  = dist1;
+	      second = first;
+	      dist1  = d;
+	      first  = idx;
+	    }
+	    else if(d < dist2) {
+	      dist2  = d;
+	      second = idx;
+	    }
+	    ++idx;
+	    ++nb;
+	  }
+	  return nb >= 2;
+	}
+
+	/**
+	 * This merges the edges collected by the jobs, removes the
+	 * edges that have not survived and adds the new ones. The
+	 * survival flags are merged into the ones of the first job.
+	 * @param data_of data_of(job) is the vq3::epoch::chl::internal::data of the job.
+	 * @return true if the graph topology has been modified.
+	 */
+	template<typename GRAPH, typename DATA_OF>
+	bool update_edges(GRAPH& g, Edges<GRAPH>& edges, unsigned int nb_jobs, const DATA_OF& data_of, const typename GRAPH::edge_value_type& value_for_new_edges) {
+	  if(nb_jobs == 0) {
+	    edges.release();
+	    return false;
+	  }
 	  
-      public:
-      
-	Processor(graph_type& g) : g(g) {}
-	Processor()                            = delete;
-	Processor(const Processor&)            = default;
-	Processor(Processor&&)                 = default;
-	Processor& operator=(const Processor&) = default;
-	Processor& operator=(Processor&&)      = default;
+	  auto& survivors = data_of(0).survivors;
+	  auto& newedges  = data_of(0).newedges;
+	  for(unsigned int job = 1; job < nb_jobs; ++job) {
+	    auto& d  = data_of(job);
+	    auto  it = d.survivors.begin();
+	    for(auto& bits : survivors) bits |= *(it++);
+	    d.newedges.foreach([&newedges](std::uint64_t key, std::uint32_t) {newedges.insert(key, 0);});
+	  }
+
+	  bool one_kill = false;
+
+	  // Let us remove non surviving edges.
+	  std::size_t idx = 0;
+	  for(auto& ref_e : edges.edges) {
+	    if((survivors[idx / 64] & (std::uint64_t(1) << (idx % 64))) == 0) {
+	      ref_e->kill();
+	      one_kill = true;
+	    }
+	    ++idx;
+	  }
+
+	  // Let us add the new edges.
+	  newedges.foreach([&g, &edges, &value_for_new_edges](std::uint64_t key, std::uint32_t) {
+	      g.connect(edges.vertices[key >> 32], edges.vertices[key & 0xffffffff], value_for_new_edges);
+	    });
+
+	  edges.release();
+	  return newedges.size() != 0 || one_kill;
+	}
 
 	/**
-	 * This processes Competitive Hebbian learning, adding or removing edges in the graph.
-	 * @return true if the process has modified the graph topology. 
+	 * This handles the graphs with less than 3 vertices.
+	 * @param modified Tells whether the topology has been modified.
+	 * @return true if the graph is handled.
 	 */
-	template<typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
-	bool process(unsigned int nb_threads,
-			const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of,
-			const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance,
-			const edge& value_for_new_edges) {
+	template<typename GRAPH>
+	bool small_graph(GRAPH& g, const typename GRAPH::edge_value_type& value_for_new_edges, bool& modified) {
 	  auto nb_vertices = g.nb_vertices();
+	  modified = false;
 	  if(nb_vertices < 2)
-	    return false;
+	    return true;
 	  if(nb_vertices == 2) {
-	    std::array<ref_vertex, 2> vertices;
+	    std::array<typename GRAPH::ref_vertex, 2> vertices;
 	    vq3::utils::collect_vertices(g,vertices.begin());
 	    auto ref_e = g.get_edge(vertices[0], vertices[1]);
 	    if(ref_e == nullptr) {
 	      g.connect(vertices[0], vertices[1], value_for_new_edges);
-	      return true;
+	      modified = true;
 	    }
-	    return false;
+	    return true;
 	  }
-	    
-	  auto iters = utils::split(samples_begin, samples_end, nb_threads);
-	  std::vector<std::future<data> > futures;
-	  auto out = std::back_inserter(futures);
-
-	  for(auto& begin_end : iters) 
-	    *(out++) = std::async(std::launch::async,
-				  [begin_end, this, &sample_of, &distance]() {
-				    data res;
-				    for(auto it = begin_end.first; it != begin_end.second; ++it) {
-				      auto two = utils::two_closest(g, sample_of(*it), distance);
-				      auto ref_e = g.get_edge(two.first, two.second);
-				      if(ref_e == nullptr)
-					res.newedges.emplace(two);
-				      else
-					res.survivors.emplace(ref_e);
-				    }
-				    return res;
-				  });
-	  
-	  std::vector<ref_edge> survivors;
-	  std::vector<refpair>  newedges;
-	  
-	  for(auto& f : futures) {
-	    auto d = f.get();
-
-	    std::vector<ref_edge> s;
-	    auto outs = std::back_inserter(s);
-	    std::set_union(survivors.begin(),   survivors.end(),
-			   d.survivors.begin(), d.survivors.end(),
-			   outs);
-	    
-	    std::vector<refpair>  n;
-	    auto outn = std::back_inserter(n);
-	    std::set_union(newedges.begin(),   newedges.end(),
-			   d.newedges.begin(), d.newedges.end(),
-			   outn);
-	    std::swap(s, survivors);
-	    std::swap(n, newedges);
+	  return false;
+	}
+      }
+      
+      template<typename GRAPH>
+      class Processor {
+      private:
 
-	  }
+	using graph_type = GRAPH;
+	using ref_vertex = typename graph_type::ref_vertex;
+	using ref_edge   = typename graph_type::ref_edge;
+	using edge       = typename graph_type::edge_value_type;
+	using data       = internal::data;
+      
+	graph_type& g;
 
-	  bool one_kill = false;
+	internal::Edges<graph_type>    edges;
+	vq3::executor::Workspace<data> workspace; // The data of the jobs are kept from one processing to the next.
+	  
+      public:
+      
+	Processor(graph_type& g) : g(g), edges(), workspace() {}
+	Processor()                            = delete;
+	Processor(const Processor&)            = default;
+	Processor(Processor&&)                 = default;
+	Processor& operator=(const Processor&) = default;
+	Processor& operator=(Processor&&)      = default;
 
-	  // Let us remove non surviving edges.
-	  utils::clear_edge_tags(g, true);
-	  for(auto& ref_e : survivors) (*ref_e)().vq3_tag = false;
-	  g.foreach_edge([&one_kill](const ref_edge& ref_e) {
-	      if((*ref_e)().vq3_tag) {
-		ref_e->kill();
-		one_kill = true;
-	      }
-	    });
+	/**
+	 * This processes Competitive Hebbian learning, adding or removing edges in the graph.
+	 * The per-job data are stored in the processor and reused by the next calls, so process must not be called concurrently on the same processor.
+	 * @param exec Either the number of threads, or an executor (see vq3::concept::Executor).
+	 * @param samples_begin, samples_end The samples. They are streamed by chunks if they are not random access iterators (see vq3::executor::stream).
+	 * @return true if the process has modified the graph topology. 
+	 */
+	template<typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
+	bool process(EXECUTOR&& exec,
+			const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of,
+			const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance,
+			const edge& value_for_new_edges) {
+	  return process(exec, samples_begin, samples_end, sample_of, epoch::internal::unit_weight(), prototype_of, distance, value_for_new_edges);
+	}
 
-	  // Let us add the new edges.
-	  for(auto& p : newedges)
-	    g.connect(p.first, p.second, value_for_new_edges);
+	/**
+	 * This is process for weighted samples. An edge is kept or
+	 * created as soon as one sample votes for it, so samples with a
+	 * positive weight vote as the repeated samples would, and the
+	 * ones with a null weight do not vote.
+	 * @param weight_of weight_of(*it) is the weight of the sample.
+	 */
+	template<typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename WEIGHT_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
+	bool process(EXECUTOR&& exec,
+			const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of,
+			const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance,
+			const edge& value_for_new_edges) {
+	  bool modified;
+	  if(internal::small_graph(g, value_for_new_edges, modified))
+	    return modified;
 
-	  return newedges.size() != 0 || one_kill;
+	  edges.vertices.clear();
+	  vq3::utils::collect_vertices(g, std::back_inserter(edges.vertices));
+	  edges.index(g);
+	    
+	  auto&& executor = vq3::executor::of(exec);
+	  auto   nb_jobs  = executor.size();
+	  workspace.prepare(nb_jobs, [nb_edges = edges.edges.size()](data& d) {d.clear(nb_edges);});
+	  auto accumulator_of = [this](unsigned int job) -> data& {return workspace[job];};
+	  auto process        = [this, &sample_of, &weight_of, &distance](data& res, const auto& it) {
+	    if constexpr (epoch::internal::is_weighted<WEIGHT_OF>)
+	      if(!(weight_of(*it) > 0))
+		return;
+	    std::uint32_t first, second;
+	    if(internal::two_closest(edges.vertices, sample_of(*it), distance, first, second))
+	      res.notify(edges, first, second);
+	  };
+	  vq3::executor::for_each(executor, samples_begin, samples_end, accumulator_of, process);
+
+	  return internal::update_edges(g, edges, nb_jobs, accumulator_of, value_for_new_edges);
 	}
       };
     
@@ -542,11 +1146,12 @@ namespace vq3 {
 	
       private:
 
-	topology_table_type& table;
+	topology_table_type&         table;
+	vq3::executor::AnyWorkspace  workspace; // The epoch data of the jobs are kept from one processing to the next.
       
       public:
       
-	Processor(topology_table_type& table) : table(table) {}
+	Processor(topology_table_type& table) : table(table), workspace() {}
 	Processor()                            = delete;
 	Processor(const Processor&)            = delete;
 	Processor(Processor&&)                 = default;
@@ -555,54 +1160,49 @@ namespace vq3 {
 
 
 	/**
-	 * @return A vector, for each prototype index, of the epoch data.
+	 * The epoch data of the jobs are stored in the processor, and
+	 * reused by the next calls. Thus process must not be called
+	 * concurrently on the same processor.
+	 * @param exec Either the number of threads, or an executor (see vq3::concept::Executor).
+	 * @param samples_begin, samples_end The samples. Random access iterators are split among the jobs, other ones (e.g. input iterators on a file) are read once and handed to the jobs by chunks (see vq3::executor::stream).
+	 * @param distance Either a distance function distance(vertex_value, sample), or a search object (see vq3::concept::Search).
+	 * @return A vector, for each prototype index, of the epoch data. It is stored in the processor, and it is only valid until the next call of process (take a copy to keep it), this saves its allocation at each epoch.
 	 */
-	template<typename EPOCH_DATA, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
-	auto process(unsigned int nb_threads, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance) {
-	  auto iters = utils::split(samples_begin, samples_end, nb_threads);
-	  std::vector<std::future<std::vector<EPOCH_DATA> > > futures;
-	  auto out = std::back_inserter(futures);
-
-	  for(auto& begin_end : iters) 
-	    *(out++) = std::async(std::launch::async,
-				  [begin_end, this, &sample_of, &distance]() {
-				    std::vector<EPOCH_DATA> data(table.size());
-				    for(auto it = begin_end.first; it != begin_end.second; ++it) {
-				      double min_dist;
-				      const auto&  sample = sample_of(*it);
-				      auto        closest = utils::closest(table.g, sample, distance, min_dist);
-				      if(closest != nullptr) {
-					auto&             d = data[table(closest)];
-					d.notify_closest(sample, min_dist);
-					d.notify_wta_update(sample);
-				      }
-				    }
-				    return data;
-				  });
-
-	  auto fit = futures.begin();
-	  if(futures.end() != fit) {
-	    auto data0 = (fit++)->get();
-	    auto b0 = data0.begin();
-	    auto e0 = data0.end();
-	    for(unsigned int thread_id = 1; thread_id < nb_threads; ++thread_id) {
-	      auto datai = (fit++)->get();
-	      auto bi = datai.begin();
-	      for(auto b = b0; b != e0; ++b, ++bi)
-		(*b) += *bi;
-	    }
-	    
-	    unsigned int idx = 0;
-	    for(auto&  d : data0) {
-	      auto& value = (*(table(idx++)))();
-	      d.set_prototype(prototype_of(value));
-	      d.set_content(value);
+	template<typename EPOCH_DATA, typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
+	auto& process(EXECUTOR&& exec, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance) {
+	  return process<EPOCH_DATA>(exec, samples_begin, samples_end, sample_of, internal::unit_weight(), prototype_of, distance);
+	}
+
+	/**
+	 * This is process for weighted samples (e.g. histogram bins, or deduplicated samples with their counts). A sample of weight w counts as w repeated samples.
+	 * @param weight_of weight_of(*it) is the weight of the sample.
+	 */
+	template<typename EPOCH_DATA, typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename WEIGHT_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
+	auto& process(EXECUTOR&& exec, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance) {
+	  search::prepare(table, distance);
+	  auto&& executor       = vq3::executor::of(exec);
+	  auto   touched        = internal::touched_per_job(samples_begin, samples_end, executor.size(), 1);
+	  auto&  ws             = internal::prepare_workspace<EPOCH_DATA>(workspace, executor.size(), table.size(), touched);
+	  auto   process        = [this, &sample_of, &weight_of, &distance](unsigned int, auto& data, const auto& it) {
+	    double min_dist;
+	    const auto&  sample = sample_of(*it);
+	    auto        closest = search::closest(table, sample, distance, min_dist);
+	    if(closest) {
+	      auto&             d = data[*closest];
+	      if constexpr (internal::is_weighted<WEIGHT_OF>) {
+		double weight = weight_of(*it);
+		d.notify_closest(sample, min_dist, weight);
+		d.notify_wta_update(sample, weight);
+	      }
+	      else {
+		d.notify_closest(sample, min_dist);
+		d.notify_wta_update(sample);
+	      }
 	    }
-	    
-	    return data0;
-	  }
-	  else
-	    return std::vector<EPOCH_DATA>();
+	  };
+	  internal::for_each(executor, ws, samples_begin, samples_end, process);
+
+	  return internal::merge_and_set(executor, table, ws, prototype_of);
 	}
       };
     
@@ -620,12 +1220,13 @@ namespace vq3 {
 
       private:
 
-	topology_table_type& table;
+	topology_table_type&         table;
+	vq3::executor::AnyWorkspace  workspace; // The epoch data of the jobs are kept from one processing to the next.
       
       public:
 
 	
-	Processor(topology_table_type& table) : table(table) {}
+	Processor(topology_table_type& table) : table(table), workspace() {}
 	Processor()                            = delete;
 	Processor(const Processor&)            = delete;
 	Processor(Processor&&)                 = default;
@@ -634,58 +1235,503 @@ namespace vq3 {
 
 
 	/**
-	 * @return A vector, for each prototype index, of the epoch data.
+	 * The epoch data of the jobs are stored in the processor, and
+	 * reused by the next calls. Thus process must not be called
+	 * concurrently on the same processor.
+	 * @param exec Either the number of threads, or an executor (see vq3::concept::Executor).
+	 * @param samples_begin, samples_end The samples. Random access iterators are split among the jobs, other ones (e.g. input iterators on a file) are read once and handed to the jobs by chunks (see vq3::executor::stream).
+	 * @param distance Either a distance function distance(vertex_value, sample), or a search object (see vq3::concept::Search).
+	 * @return A vector, for each prototype index, of the epoch data. It is stored in the processor, and it is only valid until the next call of process (take a copy to keep it), this saves its allocation at each epoch.
 	 */
-	template<typename EPOCH_DATA, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
-	auto process(unsigned int nb_threads, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance) {
-	  auto iters = utils::split(samples_begin, samples_end, nb_threads);
-	  std::vector<std::future<std::vector<EPOCH_DATA> > > futures;
-	  auto out = std::back_inserter(futures);
-
-	  for(auto& begin_end : iters) 
-	    *(out++) = std::async(std::launch::async,
-				  [begin_end, this, &sample_of, &distance, size = table.size()]() {
-				    std::vector<EPOCH_DATA> data(size);
-				    for(auto it = begin_end.first; it != begin_end.second; ++it) {
-				      double min_dist;
-				      const auto&  sample = sample_of(*it);
-				      auto        closest = utils::closest(table.g, sample, distance, min_dist);
-				      if(closest != nullptr) {
-					auto&  neighborhood = table[closest];
-					data[neighborhood.begin()->index].notify_closest(sample, min_dist);
-					for(auto& info : neighborhood) data[info.index].notify_wtm_update(sample, info.value);
-				      }
-				    }
-				    return data;
-				  });
+	template<typename EPOCH_DATA, typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
+	auto& process(EXECUTOR&& exec, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance) {
+	  return process<EPOCH_DATA>(exec, samples_begin, samples_end, sample_of, internal::unit_weight(), prototype_of, distance);
+	}
+
+	/**
+	 * This is process for weighted samples (e.g. histogram bins, or deduplicated samples with their counts). A sample of weight w counts as w repeated samples.
+	 * @param weight_of weight_of(*it) is the weight of the sample.
+	 */
+	template<typename EPOCH_DATA, typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename WEIGHT_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
+	auto& process(EXECUTOR&& exec, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance) {
+	  search::prepare(table, distance);
+	  auto&& executor       = vq3::executor::of(exec);
+	  auto   nbh_size       = table.mean_neighborhood_size(); // 0 if unknown, the dense mode is used then.
+	  auto   touched        = nbh_size > 0 ? internal::touched_per_job(samples_begin, samples_end, executor.size(), (std::size_t)(nbh_size) + 1) : 0;
+	  auto&  ws             = internal::prepare_workspace<EPOCH_DATA>(workspace, executor.size(), table.size(), touched);
+	  auto   process        = [this, &sample_of, &weight_of, &distance](unsigned int, auto& data, const auto& it) {
+	    double min_dist;
+	    const auto&  sample = sample_of(*it);
+	    auto        closest = search::closest(table, sample, distance, min_dist);
+	    if(closest) {
+	      auto&& neighborhood = table[*closest];
+	      if constexpr (internal::is_weighted<WEIGHT_OF>) {
+		double weight = weight_of(*it);
+		data[*closest].notify_closest(sample, min_dist, weight);
+		for(auto& info : neighborhood) data[info.index].notify_wtm_update(sample, weight * info.value);
+	      }
+	      else {
+		data[*closest].notify_closest(sample, min_dist);
+		for(auto& info : neighborhood) data[info.index].notify_wtm_update(sample, info.value);
+	      }
+	    }
+	  };
+	  internal::for_each(executor, ws, samples_begin, samples_end, process);
 	  
-	  auto fit = futures.begin();
-	  if(fit != futures.end()) {
-	    auto data0 = (fit++)->get();
-	    auto b0 = data0.begin();
-	    auto e0 = data0.end();
-	    for(unsigned int thread_id = 1; thread_id < nb_threads; ++thread_id) {
-	      auto datai = (fit++)->get();
-	      auto bi = datai.begin();
-	      for(auto b = b0; b != e0; ++b, ++bi)
-		(*b) += *bi;
+	  return internal::merge_and_set(executor, table, ws, prototype_of);
+	}
+      };
+    
+      template<typename TABLE>
+      auto processor(TABLE& table) {return Processor<TABLE>(table);}
+    }
+
+    /**
+     * This fuses a WTA pass and a CHL pass, for algorithms (as
+     * GNG-T) that run both on the same samples with a graph
+     * modification in between. The two closest vertices of each sample
+     * are computed once, during the WTA pass. After the graph has been
+     * modified (vertices cloned or killed), the CHL pass only
+     * rescans the samples whose closest vertices have been killed, and
+     * compares the others to the new vertices.
+     */
+    namespace wta_chl {
+
+      template<typename TABLE>
+      class Processor {
+      public:
+
+	using topology_table_type = TABLE;
+	using graph_type          = typename topology_table_type::graph_type;
+	using index_type          = typename topology_table_type::index_type;
+	using ref_vertex          = typename graph_type::ref_vertex;
+	using edge                = typename graph_type::edge_value_type;
+	
+      private:
+
+	using data = chl::internal::data;
+
+	static constexpr index_type no_index = std::numeric_limits<index_type>::max();
+
+	/**
+	 * This is the result of the WTA pass for a sample. Indices
+	 * refer to the vertices as they were at the WTA pass.
+	 */
+	template<typename ITERATOR>
+	struct Closest {
+	  ITERATOR   it;
+	  index_type first, second;
+	  double     first_dist, second_dist;
+	};
+	
+	topology_table_type&           table;
+	vq3::executor::AnyWorkspace    workspace; // The epoch data of the jobs are kept from one processing to the next.
+	vq3::executor::AnyWorkspace    closests;  // The closest vertices of each sample, collected by each job.
+	vq3::executor::Workspace<data> chl_data;  // The edges collected by each job.
+	chl::internal::Edges<graph_type> edges;
+	std::vector<ref_vertex>        scanned;   // The vertices at the WTA pass.
+	unsigned int                   nb_jobs = 0;
+      
+      public:
+      
+	Processor(topology_table_type& table) : table(table), workspace(), closests(), chl_data(), edges(), scanned() {}
+	Processor()                            = delete;
+	Processor(const Processor&)            = delete;
+	Processor(Processor&&)                 = default;
+	Processor& operator=(const Processor&) = delete;
+	Processor& operator=(Processor&&)      = delete;
+
+
+	/**
+	 * This is the WTA pass (see vq3::epoch::wta::Processor), that also collects the two closest vertices of each sample for the next call of update_edges. The closest vertices are found by a linear scan of the table. The processor stores data for update_edges, so process must not be called concurrently on the same processor.
+	 * @param samples_begin, samples_end The samples. They must be forward iterators, since update_edges revisits them: they are split among the jobs and never streamed.
+	 * @param exec Either the number of threads, or an executor (see vq3::concept::Executor).
+	 * @param distance Either a distance function distance(vertex_value, sample), or a search object (see vq3::concept::Search), whose distance function only is used.
+	 * @return A vector, for each prototype index, of the epoch data. It is stored in the processor, and it is only valid until the next call of process (take a copy to keep it), this saves its allocation at each epoch.
+	 */
+	template<typename EPOCH_DATA, typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
+	auto& process(EXECUTOR&& exec, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance) {
+	  return process<EPOCH_DATA>(exec, samples_begin, samples_end, sample_of, internal::unit_weight(), prototype_of, distance);
+	}
+
+	/**
+	 * This is process for weighted samples (see vq3::epoch::wta::Processor).
+	 * @param weight_of weight_of(*it) is the weight of the sample.
+	 */
+	template<typename EPOCH_DATA, typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename WEIGHT_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE>
+	auto& process(EXECUTOR&& exec, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance) {
+	  auto&& executor = vq3::executor::of(exec);
+	  auto&  dist     = search::distance_of(distance);
+	  auto&  ws       = internal::prepare_workspace<EPOCH_DATA>(workspace, executor.size(), table.size(),
+								    internal::touched_per_job(samples_begin, samples_end, executor.size(), 1));
+	  auto&  cs       = closests.template get<vq3::executor::Workspace<std::vector<Closest<ITERATOR>>>>();
+	  nb_jobs         = executor.size();
+	  cs.prepare(nb_jobs, [](std::vector<Closest<ITERATOR>>& c) {c.clear();});
+
+	  auto nb_vertices = table.size();
+	  scanned.clear();
+	  scanned.reserve(nb_vertices);
+	  for(index_type idx = 0; idx < nb_vertices; ++idx)
+	    scanned.push_back(table(idx));
+	  
+	  auto process = [this, &cs, &sample_of, &weight_of, &dist](unsigned int job, auto& data, const ITERATOR& it) {
+	    const auto& sample = sample_of(*it);
+	    Closest<ITERATOR> c {it, no_index, no_index, std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+	    index_type idx = 0;
+	    for(auto& ref_v : scanned) {
+	      double d = dist((*ref_v)(), sample);
+	      if(d < c.first_dist) {
+		c.second_dist = c.first_dist;
+		c.second      = c.first;
+		c.first_dist  = d;
+		c.first       = idx;
+	      }
+	      else if(d < c.second_dist) {
+		c.second_dist = d;
+		c.second      = idx;
+	      }
+	      ++idx;
 	    }
-	    
-	    unsigned int idx = 0;
-	    for(auto&  d : data0) {
-	      auto& value = (*(table(idx++)))();
-	      d.set_prototype(prototype_of(value));
-	      d.set_content(value);
+	    if(c.first != no_index) {
+	      auto& d = data[c.first];
+	      if constexpr (internal::is_weighted<WEIGHT_OF>) {
+		double weight = weight_of(*it);
+		d.notify_closest(sample, c.first_dist, weight);
+		d.notify_wta_update(sample, weight);
+	      }
+	      else {
+		d.notify_closest(sample, c.first_dist);
+		d.notify_wta_update(sample);
+	      }
 	    }
-	    return data0;
+	    cs[job].push_back(c);
+	  };
+	  internal::dispatch(executor, ws, samples_begin, samples_end, process); // update_edges revisits the samples from the stored iterators.
+
+	  return internal::merge_and_set(executor, table, ws, prototype_of);
+	}
+
+	/**
+	 * This is the CHL pass (see vq3::epoch::chl::Processor), with
+	 * the samples used at the last call of process. The graph may
+	 * have been modified since, but the prototypes of the
+	 * remaining vertices are supposed to be unchanged, and the table
+	 * must be up to date.
+	 * @param exec Either the number of threads, or an executor (see vq3::concept::Executor).
+	 * @param samples_begin, samples_end The samples given to process.
+	 * @param distance The one given to process.
+	 * @return true if the process has modified the graph topology. 
+	 */
+	template<typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename DISTANCE>
+	bool update_edges(EXECUTOR&& exec, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const DISTANCE& distance,
+			  const edge& value_for_new_edges) {
+	  return update_edges(exec, samples_begin, samples_end, sample_of, internal::unit_weight(), distance, value_for_new_edges);
+	}
+
+	/**
+	 * This is update_edges for weighted samples, the samples with a null weight do not vote (see vq3::epoch::chl::Processor).
+	 * @param weight_of weight_of(*it) is the weight of the sample.
+	 */
+	template<typename EXECUTOR, typename ITERATOR, typename SAMPLE_OF, typename WEIGHT_OF, typename DISTANCE>
+	bool update_edges(EXECUTOR&& exec, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of, const DISTANCE& distance,
+			  const edge& value_for_new_edges) {
+	  auto& cs = closests.template get<vq3::executor::Workspace<std::vector<Closest<ITERATOR>>>>();
+	  std::size_t nb_samples = 0;
+	  for(unsigned int job = 0; job < nb_jobs; ++job)
+	    nb_samples += cs[job].size();
+	  if(nb_samples != (std::size_t)(std::distance(samples_begin, samples_end)))
+	    throw std::runtime_error("vq3::epoch::wta_chl::Processor::update_edges : the samples do not match the ones of the last process call.");
+
+	  bool modified;
+	  if(chl::internal::small_graph(table.g, value_for_new_edges, modified)) {
+	    scanned.clear();
+	    return modified;
 	  }
-	  else
-	    return std::vector<EPOCH_DATA>();
+
+	  auto nb_vertices = table.size();
+	  edges.vertices.clear();
+	  edges.vertices.reserve(nb_vertices);
+	  for(index_type idx = 0; idx < nb_vertices; ++idx)
+	    edges.vertices.push_back(table(idx));
+	  edges.index(table.g);
+	  
+	  // The new vertices are the ones of the table that were not scanned.
+	  std::vector<std::uint32_t> fresh;
+	  {
+	    auto sorted = scanned;
+	    std::sort(sorted.begin(), sorted.end());
+	    for(index_type idx = 0; idx < nb_vertices; ++idx)
+	      if(!std::binary_search(sorted.begin(), sorted.end(), table(idx)))
+		fresh.push_back(idx);
+	  }
+
+	  auto& dist = search::distance_of(distance);
+	  auto update_job = [this, &cs, &fresh, &sample_of, &weight_of, &dist](unsigned int job) {
+	    auto& res = chl_data[job];
+	    for(auto& c : cs[job]) {
+	      if constexpr (internal::is_weighted<WEIGHT_OF>)
+		if(!(weight_of(*(c.it)) > 0))
+		  continue;
+	      const auto& sample = sample_of(*(c.it));
+	      std::uint32_t first, second;
+	      if(c.second == no_index || scanned[c.first]->is_killed() || scanned[c.second]->is_killed()) {
+		// The previous result is lost, let us rescan the graph.
+		if(chl::internal::two_closest(edges.vertices, sample, dist, first, second))
+		  res.notify(edges, first, second);
+		continue;
+	      }
+
+	      first  = table(scanned[c.first]);
+	      second = table(scanned[c.second]);
+	      double dist1 = c.first_dist;
+	      double dist2 = c.second_dist;
+	      for(auto idx : fresh) {
+		double d = dist((*(edges.vertices[idx]))(), sample);
+		if(d < dist1) {
+		  dist2  = dist1;
+		  second = first;
+		  dist1  = d;
+		  first  = idx;
+		}
+		else if(d < dist2) {
+		  dist2  = d;
+		  second = idx;
+		}
+	      }
+	      res.notify(edges, first, second);
+	    }
+	  };
+	  
+	  auto&& executor = vq3::executor::of(exec);
+	  chl_data.prepare(nb_jobs, [nb_edges = edges.edges.size()](data& d) {d.clear(nb_edges);});
+	  if(nb_jobs == 1)
+	    update_job(0);
+	  else {
+	    std::vector<std::future<void>> jobs;
+	    for(unsigned int job = 0; job < nb_jobs; ++job)
+	      jobs.push_back(executor.async([&update_job, job]() {update_job(job);}));
+	    vq3::executor::wait(jobs);
+	  }
+	  scanned.clear(); // This releases the killed vertices.
+
+	  return chl::internal::update_edges(table.g, edges, nb_jobs, [this](unsigned int job) -> data& {return chl_data[job];}, value_for_new_edges);
 	}
       };
     
       template<typename TABLE>
       auto processor(TABLE& table) {return Processor<TABLE>(table);}
     }
+
+    /**
+     * This runs the wta or wtm processors on random batches of the
+     * samples rather than on the whole set. The prototypes are moved
+     * toward the batch averages with a per-vertex learning rate
+     * w/W, where w is the weight of the batch samples for the vertex
+     * and W the cumulated weight of all the batches for that vertex
+     * (mini-batch k-means). When the prototypes stop moving, the
+     * batches get bigger, up to the whole set where the update is the
+     * full replacement of the usual processors. A full batch that
+     * leaves the prototypes unchanged means convergence.
+     */
+    namespace minibatch {
+
+      /** How the batch samples are drawn. */
+      enum class sampling : char {
+	random,    //!< Uniformly, without replacement.
+	stratified //!< One sample in each of the batch_size contiguous strata of the samples (relevant when the samples are sorted, see vq3::locality).
+      };
+
+      namespace internal {
+	template<typename PROCESSOR> struct batch_weight;
+	
+	template<typename TABLE>
+	struct batch_weight<vq3::epoch::wta::Processor<TABLE>> {
+	  template<typename EPOCH_DATA>
+	  static double of(const EPOCH_DATA& d) {return d.vq3_wta_accum.nb;}
+	};
+	
+	template<typename TABLE>
+	struct batch_weight<vq3::epoch::wtm::Processor<TABLE>> {
+	  template<typename EPOCH_DATA>
+	  static double of(const EPOCH_DATA& d) {return d.vq3_wtm_accum.nb;}
+	};
+      }
+
+      /**
+       * PROCESSOR is a vq3::epoch::wta::Processor or a
+       * vq3::epoch::wtm::Processor. The epoch data must thus contain
+       * vq3::epoch::data::wta or vq3::epoch::data::wtm respectively.
+       */
+      template<typename PROCESSOR>
+      class Processor {
+      public:
+
+	using topology_table_type = typename PROCESSOR::topology_table_type;
+
+      private:
+
+	topology_table_type&     table;
+	PROCESSOR                processor;
+	std::size_t              initial_batch_size;
+	std::size_t              current_batch_size;
+	double                   growth;
+	sampling                 mode;
+	bool                     has_converged;
+	std::vector<double>      cumulated; // The cumulated batch weights, for each vertex index.
+	std::vector<std::size_t> order;     // A permutation of the samples, for random batches.
+
+      public:
+
+	/**
+	 * @param table The topology table.
+	 * @param batch_size The initial batch size.
+	 * @param growth The batch size is multiplied by growth when the prototypes stop moving (it grows by at least one sample).
+	 * @param mode The way batches are drawn.
+	 */
+	Processor(topology_table_type& table, std::size_t batch_size, double growth, sampling mode)
+	  : table(table), processor(table),
+	    initial_batch_size(std::max(batch_size, (std::size_t)1)), current_batch_size(initial_batch_size),
+	    growth(growth), mode(mode), has_converged(false), cumulated(), order() {
+	  if(!(growth > 1))
+	    throw std::runtime_error("vq3::epoch::minibatch::Processor : growth must be greater than 1.");
+	}
+	
+	Processor()                            = delete;
+	Processor(const Processor&)            = delete;
+	Processor(Processor&&)                 = default;
+	Processor& operator=(const Processor&) = delete;
+	Processor& operator=(Processor&&)      = delete;
+
+	/** @return true when a full batch has left the prototypes unchanged. */
+	bool converged() const {return has_converged;}
+
+	/** @return The size of the next batch. */
+	std::size_t batch_size() const {return current_batch_size;}
+
+	/**
+	 * This restarts from the initial batch size and forgets the
+	 * cumulated weights. It has to be called when the graph is
+	 * modified, since the learning rates are stored by vertex
+	 * index.
+	 */
+	void reset() {
+	  current_batch_size = initial_batch_size;
+	  has_converged      = false;
+	  cumulated.clear();
+	}
+
+	/**
+	 * This processes one batch. It is not reentrant (see vq3::epoch::wta::Processor).
+	 * @param exec Either the number of threads, or an executor (see vq3::concept::Executor).
+	 * @param rd The random engine used for drawing the batch.
+	 * @param samples_begin, samples_end The samples (random access iterators).
+	 * @param distance Either a distance function distance(vertex_value, sample), or a search object (see vq3::concept::Search).
+	 * @param check The result of check(previous_prototype, current_prototype) should be false for all the updated vertices once they are considered to be stable. The prototypes must support p + coef * (q - p).
+	 * @return The epoch data of the batch, for each prototype index. It is stored in the processor, and it is only valid until the next call of process.
+	 */
+	template<typename EPOCH_DATA, typename EXECUTOR, typename RANDOM_ENGINE, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE, typename CHECK>
+	auto& process(EXECUTOR&& exec, RANDOM_ENGINE& rd, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance,
+		     const CHECK& check) {
+	  return process<EPOCH_DATA>(exec, rd, samples_begin, samples_end, sample_of, vq3::epoch::internal::unit_weight(), prototype_of, distance, check);
+	}
+
+	/**
+	 * This is process for weighted samples (see vq3::epoch::wta::Processor). The batches are drawn regardless of the weights.
+	 * @param weight_of weight_of(*it) is the weight of the sample.
+	 */
+	template<typename EPOCH_DATA, typename EXECUTOR, typename RANDOM_ENGINE, typename ITERATOR, typename SAMPLE_OF, typename WEIGHT_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE, typename CHECK>
+	auto& process(EXECUTOR&& exec, RANDOM_ENGINE& rd, const ITERATOR& samples_begin, const ITERATOR& samples_end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of, const PROTOTYPE_OF_VERTEX_VALUE& prototype_of, const DISTANCE& distance,
+		     const CHECK& check) {
+	  static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<ITERATOR>::iterator_category>,
+			"vq3::epoch::minibatch::Processor::process : samples must be given by random access iterators.");
+	  using prototype_type = typename EPOCH_DATA::prototype_type;
+	  
+	  std::size_t nb_samples = std::distance(samples_begin, samples_end);
+	  if(nb_samples == 0)
+	    throw std::runtime_error("vq3::epoch::minibatch::Processor::process : empty dataset.");
+	  
+	  std::vector<prototype_type> previous;
+	  previous.reserve(table.size());
+	  for(std::size_t idx = 0; idx < table.size(); ++idx)
+	    previous.push_back(prototype_of((*(table(idx)))()));
+	  if(cumulated.size() != table.size())
+	    cumulated.assign(table.size(), 0);
+
+	  bool full = current_batch_size >= nb_samples;
+	  std::vector<EPOCH_DATA>* res; // The result is stored in the processor.
+	  if(full)
+	    res = &processor.template process<EPOCH_DATA>(exec, samples_begin, samples_end, sample_of, weight_of, prototype_of, distance);
+	  else {
+	    std::vector<ITERATOR> batch;
+	    batch.reserve(current_batch_size);
+	    if(mode == sampling::stratified)
+	      for(std::size_t k = 0; k < current_batch_size; ++k) {
+		std::size_t first = (k * nb_samples) / current_batch_size;
+		std::size_t last  = ((k + 1) * nb_samples) / current_batch_size;
+		batch.push_back(samples_begin + std::uniform_int_distribution<std::size_t>(first, last - 1)(rd));
+	      }
+	    else {
+	      // Partial Fisher-Yates shuffle, the permutation is kept from one batch to the next.
+	      if(order.size() != nb_samples) {
+		order.resize(nb_samples);
+		for(std::size_t i = 0; i < nb_samples; ++i) order[i] = i;
+	      }
+	      for(std::size_t i = 0; i < current_batch_size; ++i) {
+		std::swap(order[i], order[std::uniform_int_distribution<std::size_t>(i, nb_samples - 1)(rd)]);
+		batch.push_back(samples_begin + order[i]);
+	      }
+	    }
+	    
+	    auto batch_sample_of = [&sample_of](const ITERATOR& it) -> decltype(auto) {return sample_of(*it);};
+	    if constexpr (vq3::epoch::internal::is_weighted<WEIGHT_OF>)
+	      res = &processor.template process<EPOCH_DATA>(exec, batch.begin(), batch.end(), batch_sample_of,
+							   [&weight_of](const ITERATOR& it) {return weight_of(*it);},
+							   prototype_of, distance);
+	    else
+	      res = &processor.template process<EPOCH_DATA>(exec, batch.begin(), batch.end(), batch_sample_of, prototype_of, distance);
+	  }
+
+	  bool moved = false;
+	  auto pit   = previous.begin();
+	  auto cit   = cumulated.begin();
+	  std::size_t idx = 0;
+	  for(auto& d : *res) {
+	    double w = internal::batch_weight<PROCESSOR>::of(d);
+	    if(w > 0) {
+	      auto& prototype = prototype_of((*(table(idx)))());
+	      *cit += w;
+	      if(!full)
+		prototype = *pit + (w / *cit) * (prototype - *pit);
+	      moved = moved || check(*pit, prototype);
+	    }
+	    ++pit; ++cit; ++idx;
+	  }
+
+	  if(!moved) {
+	    if(full)
+	      has_converged = true;
+	    else
+	      current_batch_size = std::min(nb_samples, std::max(current_batch_size + 1, (std::size_t)(current_batch_size * growth + .5))); // Strict growth, so that a full batch is reached.
+	  }
+	  return *res;
+	}
+      };
+
+      /**
+       * @return A mini-batch vq3::epoch::wta::Processor.
+       */
+      template<typename TABLE>
+      auto wta_processor(TABLE& table, std::size_t batch_size, double growth = 2, sampling mode = sampling::random) {
+	return Processor<vq3::epoch::wta::Processor<TABLE>>(table, batch_size, growth, mode);
+      }
+
+      /**
+       * @return A mini-batch vq3::epoch::wtm::Processor.
+       */
+      template<typename TABLE>
+      auto wtm_processor(TABLE& table, std::size_t batch_size, double growth = 2, sampling mode = sampling::random) {
+	return Processor<vq3::epoch::wtm::Processor<TABLE>>(table, batch_size, growth, mode);
+      }
+    }
   }
 }
@@ -0,0 +1,478 @@
+/*
+ *   Copyright (C) 2018,  CentraleSupelec
+ *
+ *   Author : Hervé Frezza-Buet
+ *
+ *   Contributor :
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public
+ *   License (GPL) as published by the Free Software Foundation; either
+ *   version 3 of the License, or any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *   General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *   Contact : herve.frezza-buet@centralesupelec.fr
+ *
+ */
+
+
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <stdexcept>
+#include <atomic>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <cstddef>
+#include <new>
+#include <typeinfo>
+#include <typeindex>
+
+#include <vq3Utils.hpp>
+
+namespace vq3 {
+
+  namespace concept {
+
+    /**
+     * An executor runs the jobs of the processors. The processors
+     * split their work into size() jobs, submit them, and wait for
+     * their results. A mere number of threads can be passed to the
+     * processors instead of an executor, vq3::executor::Async is used
+     * then.
+     */
+    struct Executor {
+
+      /**
+       * @return The number of jobs the work is split into.
+       */
+      unsigned int size() const;
+
+      /**
+       * This submits a job.
+       * @param job A callable, with no arguments.
+       * @return The future result of job().
+       */
+      template<typename JOB>
+      std::future<std::invoke_result_t<std::decay_t<JOB>>> async(JOB&& job);
+    };
+  }
+
+  namespace executor {
+
+    /**
+     * This executor launches a new thread for each job
+     * (std::async). This is the default behavior of the processors.
+     */
+    class Async {
+    private:
+
+      unsigned int nb_threads;
+
+    public:
+
+      Async(unsigned int nb_threads) : nb_threads(nb_threads) {}
+      Async()                        = delete;
+      Async(const Async&)            = default;
+      Async& operator=(const Async&) = default;
+
+      unsigned int size() const {return nb_threads;}
+
+      template<typename JOB>
+      auto async(JOB&& job) const {
+	return std::async(std::launch::async, std::forward<JOB>(job));
+      }
+    };
+
+    inline Async async(unsigned int nb_threads) {return Async(nb_threads);}
+
+    /**
+     * This is a pool of persistent threads, that are reused from one
+     * processing to the next. This saves the creation of threads at
+     * each call, which matters for short epochs (e.g. GNG-T on a
+     * video stream). The jobs are executed in the order of their
+     * submission. The pool must not be used by its own jobs, since
+     * a job waiting for another one may deadlock.
+     */
+    class Pool {
+    private:
+
+      std::vector<std::thread>          workers;
+      std::deque<std::function<void()>> jobs;
+      std::mutex                        mutex;
+      std::condition_variable           cv;
+      bool                              stop = false;
+
+      void work() {
+	while(true) {
+	  std::function<void()> job;
+	  {
+	    std::unique_lock<std::mutex> lock(mutex);
+	    cv.wait(lock, [this]() {return stop || !jobs.empty();});
+	    if(jobs.empty())
+	      return; // stop is true.
+	    job = std::move(jobs.front());
+	    jobs.pop_front();
+	  }
+	  job();
+	}
+      }
+
+    public:
+
+      /**
+       * @param nb_threads The number of threads, it is also the number of jobs the processors split their work into.
+       */
+      Pool(unsigned int nb_threads) : workers(), jobs(), mutex(), cv() {
+	if(nb_threads == 0)
+	  throw std::runtime_error("vq3::executor::Pool : at least one thread is required.");
+	workers.reserve(nb_threads);
+	for(unsigned int i = 0; i < nb_threads; ++i)
+	  workers.emplace_back([this]() {this->work();});
+      }
+
+      Pool()                       = delete;
+      Pool(const Pool&)            = delete;
+      Pool& operator=(const Pool&) = delete;
+
+      /**
+       * The pending jobs are executed before the threads are joined.
+       */
+      ~Pool() {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  stop = true;
+	}
+	cv.notify_all();
+	for(auto& t : workers) t.join();
+      }
+
+      unsigned int size() const {return workers.size();}
+
+      /**
+       * This gives access to the threads, e.g. for setting their
+       * affinity from their native handles.
+       */
+      std::vector<std::thread>& threads() {return workers;}
+
+      template<typename JOB>
+      auto async(JOB&& job) {
+	using result_type = std::invoke_result_t<std::decay_t<JOB>>;
+	auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<JOB>(job));
+	auto res  = task->get_future();
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  jobs.emplace_back([task]() {(*task)();});
+	}
+	cv.notify_one();
+	return res;
+      }
+    };
+
+    inline Pool pool(unsigned int nb_threads) {return Pool(nb_threads);}
+
+    /**
+     * This is used by the processors, so that they accept either an
+     * executor or a number of threads.
+     * @return an vq3::executor::Async executor.
+     */
+    inline Async of(unsigned int nb_threads) {return Async(nb_threads);}
+
+    /**
+     * This is used by the processors, so that they accept either an
+     * executor or a number of threads.
+     * @return the executor itself.
+     */
+    template<typename EXECUTOR, typename std::enable_if_t<!std::is_arithmetic_v<EXECUTOR>, int> = 0>
+    EXECUTOR& of(EXECUTOR& executor) {return executor;}
+
+    /**
+     * This processes a collection with executor.size() jobs. The
+     * collection is split into small chunks, and each job takes the
+     * next unprocessed chunk (an atomic cursor) until none is
+     * left. A job that is slowed down (costly elements, preempted
+     * thread, ...) thus handles fewer chunks, rather than delaying
+     * the others. Each job has its own accumulator. As the
+     * distribution of the chunks among the jobs varies from one call
+     * to the other, so does the order of the accumulations.
+     * @param begin, end The collection.
+     * @param accumulator_of accumulator_of(job) returns the accumulator of the job (job is in [0, executor.size()[), typically a reference to a vq3::executor::Workspace buffer.
+     * @param process process(accumulator, it) processes the element at it.
+     * @param chunks_per_job The collection is split into chunks_per_job times executor.size() chunks (or less for small collections).
+     * @return The futures of the jobs. accumulator_of and process must be kept alive until they are all ready.
+     */
+    template<typename EXECUTOR, typename IT, typename ACCUMULATOR_OF, typename PROCESS>
+    std::vector<std::future<void>> dispatch(EXECUTOR& executor, const IT& begin, const IT& end, const ACCUMULATOR_OF& accumulator_of, const PROCESS& process, unsigned int chunks_per_job = 8) {
+      auto nb_jobs   = executor.size();
+      auto nb_chunks = (unsigned int)(std::min((std::size_t)(std::distance(begin, end)), (std::size_t)nb_jobs * chunks_per_job));
+      auto chunks    = std::make_shared<std::vector<std::pair<IT, IT>>>(utils::split(begin, end, nb_chunks));
+      auto cursor    = std::make_shared<std::atomic<std::size_t>>(0);
+
+      std::vector<std::future<void>> futures;
+      for(unsigned int job = 0; job < nb_jobs; ++job)
+	futures.push_back(executor.async([chunks, cursor, job, &accumulator_of, &process]() {
+	      auto&& acc = accumulator_of(job);
+	      for(std::size_t c = (*cursor)++; c < chunks->size(); c = (*cursor)++)
+		for(auto it = (*chunks)[c].first, chunk_end = (*chunks)[c].second; it != chunk_end; ++it)
+		  process(acc, it);
+	    }));
+      return futures;
+    }
+
+    /**
+     * This waits for all the futures, and then gets them, so that
+     * the exception thrown by a job (if any) is rethrown once all the
+     * jobs are over.
+     */
+    template<typename FUTURES>
+    void wait(FUTURES& futures) {
+      for(auto& f : futures) f.wait();
+      for(auto& f : futures) f.get();
+    }
+
+    /**
+     * This processes a single-pass collection (e.g. input iterators
+     * reading a file or a socket) with executor.size() jobs. The
+     * calling thread reads the collection once, copies its elements
+     * into chunks of chunk_size elements, and hands them to the jobs
+     * through a bounded queue. The memory used is thus bounded,
+     * whatever the size of the collection. The chunk buffers are
+     * reused. As for dispatch, the order of the accumulations varies
+     * from one call to the other. This returns when all the elements
+     * are processed.
+     * @param begin, end The collection, read once.
+     * @param accumulator_of accumulator_of(job) returns the accumulator of the job (job is in [0, executor.size()[).
+     * @param process process(accumulator, it) processes the element at it, which is an iterator on a chunk buffer.
+     * @param chunk_size The number of elements in a chunk.
+     * @param queue_size The maximal number of chunks waiting for a job (0 means twice the number of jobs).
+     */
+    template<typename EXECUTOR, typename IT, typename ACCUMULATOR_OF, typename PROCESS>
+    void stream(EXECUTOR& executor, IT begin, const IT& end, const ACCUMULATOR_OF& accumulator_of, const PROCESS& process,
+		std::size_t chunk_size = 1024, std::size_t queue_size = 0) {
+      using chunk_type = std::vector<typename std::iterator_traits<IT>::value_type>;
+
+      auto nb_jobs = executor.size();
+      if(nb_jobs == 0)
+	throw std::runtime_error("vq3::executor::stream : at least one job is required.");
+      if(chunk_size == 0)
+	throw std::runtime_error("vq3::executor::stream : chunks cannot be empty.");
+      if(queue_size == 0)
+	queue_size = 2 * nb_jobs;
+
+      std::mutex              mutex;
+      std::condition_variable not_empty;
+      std::condition_variable not_full;
+      std::deque<chunk_type>  pending;
+      std::vector<chunk_type> recycled;
+      bool                    done  = false; // The collection is entirely read.
+      bool                    abort = false; // A job or the reading has failed.
+
+      auto stop = [&mutex, &abort, &not_empty, &not_full]() {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  abort = true;
+	}
+	not_empty.notify_all();
+	not_full.notify_all();
+      };
+
+      std::vector<std::future<void>> futures;
+      for(unsigned int job = 0; job < nb_jobs; ++job)
+	futures.push_back(executor.async([&, job]() {
+	      try {
+		auto&& acc = accumulator_of(job);
+		while(true) {
+		  chunk_type chunk;
+		  {
+		    std::unique_lock<std::mutex> lock(mutex);
+		    not_empty.wait(lock, [&]() {return abort || done || !pending.empty();});
+		    if(abort || pending.empty())
+		      return;
+		    chunk = std::move(pending.front());
+		    pending.pop_front();
+		  }
+		  not_full.notify_one();
+		  for(auto it = chunk.cbegin(); it != chunk.cend(); ++it)
+		    process(acc, it);
+		  chunk.clear();
+		  std::lock_guard<std::mutex> lock(mutex);
+		  recycled.push_back(std::move(chunk));
+		}
+	      }
+	      catch(...) {
+		stop();
+		throw;
+	      }
+	    }));
+
+      try {
+	while(begin != end) {
+	  chunk_type chunk;
+	  {
+	    std::lock_guard<std::mutex> lock(mutex);
+	    if(!recycled.empty()) {
+	      chunk = std::move(recycled.back());
+	      recycled.pop_back();
+	    }
+	  }
+	  chunk.reserve(chunk_size);
+	  for(; begin != end && chunk.size() < chunk_size; ++begin)
+	    chunk.emplace_back(*begin);
+
+	  {
+	    std::unique_lock<std::mutex> lock(mutex);
+	    not_full.wait(lock, [&]() {return abort || pending.size() < queue_size;});
+	    if(abort)
+	      break;
+	    pending.push_back(std::move(chunk));
+	  }
+	  not_empty.notify_one();
+	}
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  done = true;
+	}
+	not_empty.notify_all();
+      }
+      catch(...) {
+	stop();
+	for(auto& f : futures) f.wait(); // The jobs use local variables.
+	throw;
+      }
+      wait(futures);
+    }
+
+    /**
+     * This processes a collection with executor.size() jobs, as
+     * dispatch does (followed by a wait) for random access
+     * iterators. Other iterators are processed by stream, since they
+     * cannot be split efficiently.
+     * @param process process(accumulator, it) processes the element at it. The type of it depends on the kind of iterator.
+     */
+    template<typename EXECUTOR, typename IT, typename ACCUMULATOR_OF, typename PROCESS>
+    void for_each(EXECUTOR& executor, const IT& begin, const IT& end, const ACCUMULATOR_OF& accumulator_of, const PROCESS& process) {
+      if constexpr (std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<IT>::iterator_category>) {
+	auto futures = dispatch(executor, begin, end, accumulator_of, process);
+	wait(futures);
+      }
+      else
+	stream(executor, begin, end, accumulator_of, process);
+    }
+
+    /** The assumed size of a cache line. */
+    constexpr std::size_t cache_line_size = 64;
+
+    /**
+     * This allocator aligns the allocated arrays on cache lines, so
+     * that arrays used by distinct threads do not share a cache line
+     * (false sharing).
+     */
+    template<typename T>
+    struct CacheAligned {
+      using value_type = T;
+
+      CacheAligned() = default;
+      template<typename U> CacheAligned(const CacheAligned<U>&) {}
+
+      T* allocate(std::size_t n) {
+	return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(std::max(cache_line_size, alignof(T)))));
+      }
+
+      void deallocate(T* p, std::size_t) {
+	::operator delete(p, std::align_val_t(std::max(cache_line_size, alignof(T))));
+      }
+
+      template<typename U> bool operator==(const CacheAligned<U>&) const {return true;}
+      template<typename U> bool operator!=(const CacheAligned<U>&) const {return false;}
+    };
+
+    /**
+     * This keeps one buffer per job alive from one processing to the
+     * next, so that the jobs reuse them (they are reset rather than
+     * reallocated). Buffers are aligned on cache lines.
+     */
+    template<typename BUFFER>
+    class Workspace {
+    private:
+
+      struct alignas(cache_line_size) Slot {
+	BUFFER buffer;
+      };
+
+      std::vector<Slot> slots;
+
+    public:
+
+      using buffer_type = BUFFER;
+
+      /**
+       * This makes nb_jobs buffers available, and resets them.
+       * @param reset reset(buffer) resets a buffer.
+       */
+      template<typename RESET>
+      void prepare(std::size_t nb_jobs, const RESET& reset) {
+	if(slots.size() < nb_jobs)
+	  slots.resize(nb_jobs);
+	for(std::size_t job = 0; job < nb_jobs; ++job)
+	  reset(slots[job].buffer);
+      }
+
+      BUFFER& operator[](std::size_t job) {return slots[job].buffer;}
+
+      /** @return The number of buffers, some may be left from a previous preparation for more jobs. */
+      std::size_t size() const {return slots.size();}
+    };
+
+    /**
+     * This holds a workspace whose type is only known when it is used
+     * (e.g. it depends on the epoch data type given to a
+     * processor). It is replaced when another type is required. Copies
+     * do not share the workspace.
+     */
+    class AnyWorkspace {
+    private:
+
+      std::shared_ptr<void> workspace;
+      std::type_index       type = typeid(void);
+
+    public:
+
+      AnyWorkspace()                           = default;
+      AnyWorkspace(const AnyWorkspace&) : AnyWorkspace() {}
+      AnyWorkspace(AnyWorkspace&&)             = default;
+      AnyWorkspace& operator=(AnyWorkspace&&)  = default;
+      AnyWorkspace& operator=(const AnyWorkspace&) {
+	workspace.reset();
+	type = typeid(void);
+	return *this;
+      }
+
+      template<typename WORKSPACE>
+      WORKSPACE& get() {
+	if(type != typeid(WORKSPACE)) {
+	  workspace = std::make_shared<WORKSPACE>();
+	  type      = typeid(WORKSPACE);
+	}
+	return *static_cast<WORKSPACE*>(workspace.get());
+      }
+    };
+  }
+}
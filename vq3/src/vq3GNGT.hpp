@@ -124,9 +124,10 @@ namespace vq3 {
 	vq3::epoch::wta::Processor<topology_table_type> wta;
 	vq3::epoch::wta::Processor<topology_table_type> bmu;
 	vq3::epoch::chl::Processor<graph_type>          chl;
+	vq3::epoch::wta_chl::Processor<topology_table_type> bmu_chl;
 
 	Processor(topology_table_type& table)
-	  : table(table), wta(table), bmu(table), chl(table.g) {
+	  : table(table), wta(table), bmu(table), chl(table.g), bmu_chl(table) {
 	}
 	
 	Processor()                            = delete;
@@ -141,17 +142,34 @@ namespace vq3 {
 	 * @param sample_of The samples are obtained from sample_of(*it).
 	 * @param ref_prototype_of_vertex Returns a reference to the prototype from the vertex value.
 	 * @param clone_prototype Computes a prototype value that is close to (*ref_v)().vq3_value.
-	 * @param distance Compares the vertex value to a sample.
+	 * @param distance Compares the vertex value to a sample. It can also be a search object (see vq3::concept::Search), used for the BMU pass. With a mere distance function, the BMU and CHL passes are fused (see vq3::epoch::wta_chl), so that the samples are compared to all the vertices once.
 	 * @param evolution Modifies the graph. See vq3::algo::gngt::by_default::evolution for an example.
+	 * @param exec Either the number of threads, or an executor (see vq3::concept::Executor). A persistent vq3::executor::Pool saves the creation of threads at each call.
 	 */
-	template<typename ITER, typename PROTOTYPE_OF_VERTEX, typename SAMPLE_OF, typename EVOLUTION, typename CLONE_PROTOTYPE, typename DISTANCE>
-	void process(unsigned int nb_threads,
+	template<typename EXECUTOR, typename ITER, typename PROTOTYPE_OF_VERTEX, typename SAMPLE_OF, typename EVOLUTION, typename CLONE_PROTOTYPE, typename DISTANCE>
+	void process(EXECUTOR&& exec,
 		     const ITER& begin, const ITER& end,
 		     const SAMPLE_OF& sample_of,
 		     const PROTOTYPE_OF_VERTEX& ref_prototype_of_vertex,
 		     const CLONE_PROTOTYPE& clone_prototype,
 		     const DISTANCE& distance,
 		     EVOLUTION& evolution) {
+	  process(exec, begin, end, sample_of, vq3::epoch::internal::unit_weight(), ref_prototype_of_vertex, clone_prototype, distance, evolution);
+	}
+
+	/**
+	 * This is process for weighted samples (e.g. a vq3::coreset), a sample of weight w counts as w repeated samples.
+	 * @param weight_of weight_of(*it) is the weight of the sample.
+	 */
+	template<typename EXECUTOR, typename ITER, typename PROTOTYPE_OF_VERTEX, typename SAMPLE_OF, typename WEIGHT_OF, typename EVOLUTION, typename CLONE_PROTOTYPE, typename DISTANCE>
+	void process(EXECUTOR&& exec,
+		     const ITER& begin, const ITER& end,
+		     const SAMPLE_OF& sample_of,
+		     const WEIGHT_OF& weight_of,
+		     const PROTOTYPE_OF_VERTEX& ref_prototype_of_vertex,
+		     const CLONE_PROTOTYPE& clone_prototype,
+		     const DISTANCE& distance,
+		     EVOLUTION& evolution) {
  	  if(begin == end) {
 	    table.g.foreach_vertex([](const ref_vertex& ref_v) {ref_v->kill();});
 	    table();
@@ -160,18 +178,29 @@ namespace vq3 {
 
 	  if(table.size() == 0) {
 	    // empty graph, we create one vertex, and do one wta pass.
-	    table.g += sample_of(*begin);
+	    table.g += PROTOTYPE(sample_of(*begin));
 	    table();
-	    wta.template process<epoch_wta>(nb_threads, begin, end, sample_of, ref_prototype_of_vertex, distance);
+	    wta.template process<epoch_wta>(exec, begin, end, sample_of, weight_of, ref_prototype_of_vertex, distance);
 	    return;
 	  }
 
-	  auto bmu_results = bmu.template process<epoch_bmu>(nb_threads, begin, end, sample_of, ref_prototype_of_vertex, distance);
+	  if constexpr (vq3::search::is_search<DISTANCE>::value) {
+	    auto& bmu_results = bmu.template process<epoch_bmu>(exec, begin, end, sample_of, weight_of, ref_prototype_of_vertex, distance);
 	  
-	  evolution(table, bmu_results, clone_prototype);
-	  table();
+	    evolution(table, bmu_results, clone_prototype);
+	    table();
 	  
-	  chl.process(nb_threads, begin, end, sample_of, ref_prototype_of_vertex, distance, edge());
+	    chl.process(exec, begin, end, sample_of, weight_of, ref_prototype_of_vertex, vq3::search::distance_of(distance), edge());
+	  }
+	  else {
+	    // The epoch_bmu data do not move the prototypes, so the closest vertices found by the BMU pass are still valid for CHL.
+	    auto& bmu_results = bmu_chl.template process<epoch_bmu>(exec, begin, end, sample_of, weight_of, ref_prototype_of_vertex, distance);
+
+	    evolution(table, bmu_results, clone_prototype);
+	    table();
+
+	    bmu_chl.update_edges(exec, begin, end, sample_of, weight_of, distance, edge());
+	  }
 	}
 	
       };
@@ -31,6 +31,7 @@
 #include <memory>
 #include <list> 
 #include <utility>
+#include <cstddef>
 
 
 namespace vq3 {
@@ -120,8 +121,10 @@ namespace vq3 {
     friend class graph<VERTEX_VALUE, EDGE_VALUE>;
     
     std::list<std::weak_ptr<edge<VERTEX_VALUE, EDGE_VALUE> > > E;
+    std::size_t table_stamp;
+    std::size_t table_index;
     
-    vertex(const VERTEX_VALUE& v) : valued_graph_element<VERTEX_VALUE, VERTEX_VALUE, EDGE_VALUE>(v), E() {}
+    vertex(const VERTEX_VALUE& v) : valued_graph_element<VERTEX_VALUE, VERTEX_VALUE, EDGE_VALUE>(v), E(), table_stamp(0), table_index(0) {}
       
   public:
     
@@ -132,6 +135,29 @@ namespace vq3 {
     vertex(const vertex&)            = delete;
     vertex& operator=(const vertex&) = delete;
 
+    /**
+     * This is used by vq3::topology::Table, that stores in the vertex
+     * its index, in order to retrieve it in constant time. The stamp
+     * identifies the table filling that has set the index, 0 is
+     * reserved for "no filling".
+     */
+    void set_table_index(std::size_t stamp, std::size_t index) {
+      table_stamp = stamp;
+      table_index = index;
+    }
+
+    /**
+     * @param stamp The stamp of the table filling.
+     * @param index returns by reference the index of the vertex, if it has been set by that filling.
+     * @return false if the vertex index has not been set by that filling.
+     */
+    bool get_table_index(std::size_t stamp, std::size_t& index) const {
+      if(stamp == 0 || table_stamp != stamp)
+	return false;
+      index = table_index;
+      return true;
+    }
+
     template<typename EDGE_FUN>
     void foreach_edge(const EDGE_FUN& fun) {
       auto it =  E.begin();
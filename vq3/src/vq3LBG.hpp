@@ -39,27 +39,29 @@
 #include <sstream>
 #include <vector>
 #include <iomanip>
+#include <type_traits>
 
 namespace vq3 {
   namespace algo {
     /**
      * This is the Linde-Buzo-Gray algorithm.
      * @param rd the random engine.
-     * @param nb_threads the number of threads used for computing LBG.
+     * @param exec Either the number of threads used for computing LBG, or an executor (see vq3::concept::Executor).
      * @param g the graph, it is cleared, and then k vertices are added.
      * @param k the number of vertices required.
      * @param begin, end The samples
      * @param sample_of The samples are obtained from sample_of(*it).
+     * @param weight_of weight_of(*it) is the weight of the sample, a sample of weight w counts as w repeated samples.
      * @param prototype_of prototype_of(vertex_value) is a **reference** to the prototype.
      * @param distance distance(prototype, sample) is used internally.
      * @param nearly nearly(p) produces a prototype that is slightly different from p.
      * @param check The result of check(previous_vertex_value, current_vertex_value) should be false for all vertex once convergence is considered to be reached.
      * @param verbose Toggles verbosity.
      */
-    template<typename PROTOTYPE, typename RANDOM_ENGINE, typename GRAPH, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE, typename NEARLY, typename CHECK>
+    template<typename PROTOTYPE, typename RANDOM_ENGINE, typename EXECUTOR, typename GRAPH, typename ITERATOR, typename SAMPLE_OF, typename WEIGHT_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE, typename NEARLY, typename CHECK>
     void lbg(RANDOM_ENGINE& rd,
-	     unsigned int nb_threads, GRAPH& g, unsigned int k,
-	     const ITERATOR& begin, const ITERATOR& end, const SAMPLE_OF& sample_of,
+	     EXECUTOR&& exec, GRAPH& g, unsigned int k,
+	     const ITERATOR& begin, const ITERATOR& end, const SAMPLE_OF& sample_of, const WEIGHT_OF& weight_of,
 	     const PROTOTYPE_OF_VERTEX_VALUE& prototype_of,
 	     const DISTANCE& distance,
 	     const NEARLY& nearly,
@@ -78,10 +80,16 @@ namespace vq3 {
       
       g.foreach_vertex([](const typename GRAPH::ref_vertex& ref_v){ref_v->kill();});
 
+      // The samples may differ from the prototypes (e.g. vq3::sparse::Vector samples for vq3::sparse::Dense prototypes).
+      using sample_type = std::decay_t<decltype(sample_of(*begin))>;
+      using epoch_data  = typename vq3::epoch::data::delta<typename vq3::epoch::data::wta<typename epoch::data::none<sample_type,
+														    typename GRAPH::vertex_value_type,
+														    PROTOTYPE> > >;
+
       auto table = vq3::topology::table(g);
       auto wta   = vq3::epoch::wta::processor(table);
       
-      g += sample_of(*begin);
+      g += PROTOTYPE(sample_of(*begin));
       unsigned int nb_nodes = 1;
       table();
 
@@ -90,13 +98,7 @@ namespace vq3 {
 		  << "Starting Linde-Buzo-Gray with K =" << std::setw(4) << k << "." << std::endl
 		  << "--------------------------------------" << std::endl;
 
-      wta.template process<typename vq3::epoch::data::delta<typename vq3::epoch::data::wta<typename epoch::data::none<PROTOTYPE,
-														      typename GRAPH::vertex_value_type,
-														      PROTOTYPE> > > >(nb_threads,
-																       begin, end,
-																       sample_of,
-																       prototype_of,
-																       distance);
+      wta.template process<epoch_data>(exec, begin, end, sample_of, weight_of, prototype_of, distance);
       
       while(nb_nodes < k) {
 	unsigned int new_nb_nodes = std::min(k, 2*nb_nodes);
@@ -116,13 +118,7 @@ namespace vq3 {
 
 	bool stop = false;
 	while(!stop) {
-	  auto res = wta.template process<typename vq3::epoch::data::delta<typename vq3::epoch::data::wta<typename epoch::data::none<PROTOTYPE,
-																     typename GRAPH::vertex_value_type,
-																     PROTOTYPE> > > >(nb_threads,
-																		      begin, end,
-																		      sample_of,
-																		      prototype_of,
-																		      distance);
+	  auto& res = wta.template process<epoch_data>(exec, begin, end, sample_of, weight_of, prototype_of, distance);
 	  stop = true;
 	  for(auto& d : res)
 	    if(check(d.vq3_previous_prototype, d.vq3_current_prototype)) {
@@ -136,5 +132,20 @@ namespace vq3 {
 	std::cout << "Done." << std::endl
 		  << std::endl;
     }
+
+    /**
+     * This is the Linde-Buzo-Gray algorithm, with samples of weight 1.
+     */
+    template<typename PROTOTYPE, typename RANDOM_ENGINE, typename EXECUTOR, typename GRAPH, typename ITERATOR, typename SAMPLE_OF, typename PROTOTYPE_OF_VERTEX_VALUE, typename DISTANCE, typename NEARLY, typename CHECK>
+    void lbg(RANDOM_ENGINE& rd,
+	     EXECUTOR&& exec, GRAPH& g, unsigned int k,
+	     const ITERATOR& begin, const ITERATOR& end, const SAMPLE_OF& sample_of,
+	     const PROTOTYPE_OF_VERTEX_VALUE& prototype_of,
+	     const DISTANCE& distance,
+	     const NEARLY& nearly,
+	     const CHECK& check,
+	     bool verbose) {
+      lbg<PROTOTYPE>(rd, exec, g, k, begin, end, sample_of, vq3::epoch::internal::unit_weight(), prototype_of, distance, nearly, check, verbose);
+    }
   }
 }
@@ -0,0 +1,226 @@
+/*
+ *   Copyright (C) 2018,  CentraleSupelec
+ *
+ *   Author : Hervé Frezza-Buet
+ *
+ *   Contributor :
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public
+ *   License (GPL) as published by the Free Software Foundation; either
+ *   version 3 of the License, or any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *   General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *   Contact : herve.frezza-buet@centralesupelec.fr
+ *
+ */
+
+
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <future>
+
+#include <vq3Utils.hpp>
+#include <vq3Search.hpp>
+#include <vq3Executor.hpp>
+
+namespace vq3 {
+
+  /**
+   * The processors split the samples into contiguous chunks, that
+   * the threads claim dynamically (see vq3::executor::dispatch). If
+   * the samples of a chunk are close in the input space, they are
+   * likely to share the same BMUs, and thus the same neighborhoods
+   * and epoch data, which is cache friendly. The functions here
+   * reorder a collection of samples (random access iterators)
+   * accordingly, once, before the epochs.
+   */
+  namespace locality {
+
+    /**
+     * This reorders the samples according to their keys. keys[i] is
+     * the (key, position) pair of the sample at position i, the sort
+     * is stable since positions break the ties.
+     */
+    template<typename RANDOM_IT, typename KEY>
+    void reorder(const RANDOM_IT& begin, const RANDOM_IT& end, std::vector<std::pair<KEY, std::size_t>>& keys) {
+      if(keys.size() != (std::size_t)(std::distance(begin, end)))
+	throw std::runtime_error("vq3::locality::reorder : keys and samples sizes mismatch.");
+      std::sort(keys.begin(), keys.end());
+      std::vector<typename std::iterator_traits<RANDOM_IT>::value_type> tmp;
+      tmp.reserve(keys.size());
+      for(auto& k : keys)
+	tmp.push_back(std::move(*(begin + k.second)));
+      std::move(tmp.begin(), tmp.end(), begin);
+    }
+
+    namespace internal {
+
+      // This computes, for each sample, its coordinates quantized on nb_bits bits (1 to 63) in the bounding box.
+      template<typename RANDOM_IT, typename COORDS_OF>
+      std::vector<std::vector<std::uint64_t>> quantize(const RANDOM_IT& begin, const RANDOM_IT& end, const COORDS_OF& coords_of, unsigned int nb_bits, std::size_t& dim) {
+	std::vector<double> min, max;
+	dim = 0;
+	for(auto it = begin; it != end; ++it) {
+	  const auto& coords = coords_of(*it);
+	  if(it == begin) {
+	    min.assign(coords.begin(), coords.end());
+	    max = min;
+	    dim = min.size();
+	  }
+	  else {
+	    auto mit = min.begin();
+	    auto Mit = max.begin();
+	    for(double c : coords) {
+	      *mit = std::min(*mit, c); ++mit;
+	      *Mit = std::max(*Mit, c); ++Mit;
+	    }
+	  }
+	}
+
+	std::uint64_t max_q = (std::uint64_t(1) << nb_bits) - 1;
+	double        top   = (double)max_q; // Rounded up beyond 53 bits, hence the clamping below.
+	std::vector<std::vector<std::uint64_t>> res;
+	res.reserve(std::distance(begin, end));
+	for(auto it = begin; it != end; ++it) {
+	  std::vector<std::uint64_t> q;
+	  q.reserve(dim);
+	  auto mit = min.begin();
+	  auto Mit = max.begin();
+	  for(double c : coords_of(*it)) {
+	    double range = *(Mit++) - *mit;
+	    q.push_back(range > 0 ? std::min(max_q, (std::uint64_t)((c - *mit)/range*top + .5)) : 0);
+	    ++mit;
+	  }
+	  res.push_back(std::move(q));
+	}
+	return res;
+      }
+    }
+
+    /**
+     * This sorts the samples along a Morton (Z-order) curve.
+     * @param begin, end The samples (random access iterators).
+     * @param coords_of coords_of(sample) returns the (iterable) collection of the sample coordinates.
+     * @param nb_bits The number of bits for quantizing each coordinate. It is reduced if needed so that the key fits 64 bits, the samples can thus have at most 64 coordinates.
+     */
+    template<typename RANDOM_IT, typename COORDS_OF>
+    void morton(const RANDOM_IT& begin, const RANDOM_IT& end, const COORDS_OF& coords_of, unsigned int nb_bits = 16) {
+      if(begin == end)
+	return;
+      std::size_t dim;
+      std::vector<std::vector<std::uint64_t>> q;
+      {
+	std::size_t d = 0;
+	for(auto c : coords_of(*begin)) {(void)c; ++d;}
+	if(d == 0)
+	  throw std::runtime_error("vq3::locality::morton : samples have no coordinates.");
+	if(d > 64)
+	  throw std::runtime_error("vq3::locality::morton : samples have more than 64 coordinates, their keys cannot fit 64 bits.");
+	nb_bits = std::max(std::min({nb_bits, (unsigned int)(64/d), (unsigned int)63}), (unsigned int)1);
+	q = internal::quantize(begin, end, coords_of, nb_bits, dim);
+      }
+
+      std::vector<std::pair<std::uint64_t, std::size_t>> keys;
+      keys.reserve(q.size());
+      std::size_t pos = 0;
+      for(auto& coords : q) {
+	std::uint64_t key = 0;
+	for(int b = nb_bits - 1; b >= 0; --b)
+	  for(auto c : coords)
+	    key = (key << 1) | ((c >> b) & 1);
+	keys.emplace_back(key, pos++);
+      }
+      reorder(begin, end, keys);
+    }
+
+    /**
+     * This sorts 2D samples along a Hilbert curve, which has better
+     * locality than the Morton one.
+     * @param begin, end The samples (random access iterators).
+     * @param coords_of coords_of(sample) returns the (iterable) collection of the 2 sample coordinates.
+     * @param nb_bits The number of bits for quantizing each coordinate (at most 31).
+     */
+    template<typename RANDOM_IT, typename COORDS_OF>
+    void hilbert(const RANDOM_IT& begin, const RANDOM_IT& end, const COORDS_OF& coords_of, unsigned int nb_bits = 16) {
+      if(begin == end)
+	return;
+      nb_bits = std::max(std::min(nb_bits, (unsigned int)31), (unsigned int)1);
+      std::size_t dim;
+      auto q = internal::quantize(begin, end, coords_of, nb_bits, dim);
+      if(dim != 2)
+	throw std::runtime_error("vq3::locality::hilbert : samples must have 2 coordinates.");
+
+      std::vector<std::pair<std::uint64_t, std::size_t>> keys;
+      keys.reserve(q.size());
+      std::size_t pos = 0;
+      std::uint64_t n = std::uint64_t(1) << nb_bits;
+      for(auto& coords : q) {
+	std::uint64_t x = coords[0];
+	std::uint64_t y = coords[1];
+	std::uint64_t key = 0;
+	for(std::uint64_t s = n/2; s > 0; s /= 2) {
+	  std::uint64_t rx = (x & s) > 0;
+	  std::uint64_t ry = (y & s) > 0;
+	  key += s * s * ((3 * rx) ^ ry);
+	  if(ry == 0) { // rotation of the quadrant.
+	    if(rx == 1) {
+	      x = n - 1 - x;
+	      y = n - 1 - y;
+	    }
+	    std::swap(x, y);
+	  }
+	}
+	keys.emplace_back(key, pos++);
+      }
+      reorder(begin, end, keys);
+    }
+
+    /**
+     * This sorts the samples according to the index of their BMU in
+     * the table, so that the samples of a chunk claimed by a thread
+     * in the next epochs hit a few contiguous vertices. This is
+     * relevant when the prototypes are not expected to move much
+     * (e.g. warm-started epochs).
+     * @param exec Either the number of threads used for the BMU computation, or an executor (see vq3::concept::Executor).
+     * @param table The topology table, it must be up to date.
+     * @param begin, end The samples (random access iterators).
+     * @param sample_of sample_of(*it) returns the sample.
+     * @param distance A distance function or a search object (see vq3::concept::Search).
+     */
+    template<typename EXECUTOR, typename TABLE, typename RANDOM_IT, typename SAMPLE_OF, typename DISTANCE>
+    void by_bmu(EXECUTOR&& exec, TABLE& table, const RANDOM_IT& begin, const RANDOM_IT& end, const SAMPLE_OF& sample_of, const DISTANCE& distance) {
+      std::vector<std::pair<std::size_t, std::size_t>> keys(std::distance(begin, end));
+      search::prepare(table, distance);
+
+      auto&& executor = vq3::executor::of(exec);
+      auto no_accum   = [](unsigned int) {return 0;};
+      auto process    = [begin, &keys, &table, &sample_of, &distance](int, const RANDOM_IT& it) {
+	double min_dist;
+	auto closest = search::closest(table, sample_of(*it), distance, min_dist);
+	std::size_t pos = std::distance(begin, it);
+	keys[pos] = {closest ? (std::size_t)(*closest) : std::numeric_limits<std::size_t>::max(), pos};
+      };
+      auto futures = vq3::executor::dispatch(executor, begin, end, no_accum, process);
+      vq3::executor::wait(futures);
+      reorder(begin, end, keys);
+    }
+  }
+}
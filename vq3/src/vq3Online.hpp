@@ -8,7 +8,7 @@ namespace vq3 {
       template<typename TABLE, typename SAMPLE, typename DISTANCE>
       auto learn(TABLE& table, const DISTANCE& dist, const SAMPLE& xi, double alpha) {
 	auto ref_v = vq3::utils::closest(table.g, xi , [&dist](const typename TABLE::graph_type::vertex_type::value_type& v, const SAMPLE& p) {return dist(v.vq3_value, p);});
-	auto& n = table[ref_v];
+	auto&& n = table[ref_v];
 	for(auto& info : n) {
 	  auto& w = (*(table(info.index)))().vq3_value;
 	  w += alpha*info.value*(xi-w);
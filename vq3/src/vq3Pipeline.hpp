@@ -0,0 +1,251 @@
+/*
+ *   Copyright (C) 2018,  CentraleSupelec
+ *
+ *   Author : Hervé Frezza-Buet
+ *
+ *   Contributor :
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public
+ *   License (GPL) as published by the Free Software Foundation; either
+ *   version 3 of the License, or any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *   General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *   Contact : herve.frezza-buet@centralesupelec.fr
+ *
+ */
+
+
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+namespace vq3 {
+
+  /**
+   * A pipeline prepares the next batches of samples (acquisition,
+   * sampling, reordering, ...) while the current one is learned. Each
+   * stage runs in its own thread. A fixed number of batch buffers
+   * circulate from one stage to the next, and then to the consumer,
+   * which gives them back when it is done. A stage waits when no
+   * buffer is available (back-pressure), so the memory is bounded,
+   * and the throughput is driven by the slowest stage rather than by
+   * the sum of the stage costs.
+   */
+  namespace pipeline {
+
+    template<typename BATCH>
+    class Pipeline {
+    private:
+
+      using stage_type = std::function<bool (BATCH&)>;
+
+      /** A batch waiting between two stages. */
+      struct Queue {
+	std::deque<BATCH*> batches;
+	bool               closed = false; // No more batches will be pushed.
+      };
+
+      std::vector<BATCH>       buffers;
+      std::vector<stage_type>  stages;
+      std::vector<Queue>       queues; // queues[0] are the free buffers, queues[k] feed the stage k, queues.back() feeds the consumer.
+      std::vector<std::thread> threads;
+      std::mutex               mutex;
+      std::condition_variable  cv;
+      bool                     halt = false;
+      std::exception_ptr       error;
+
+      void give_back(BATCH* batch) {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  queues[0].batches.push_back(batch);
+	}
+	cv.notify_all();
+      }
+
+      void run(std::size_t stage) {
+	auto& in  = queues[stage];
+	auto& out = queues[stage + 1];
+	try {
+	  while(true) {
+	    BATCH* batch;
+	    {
+	      std::unique_lock<std::mutex> lock(mutex);
+	      cv.wait(lock, [this, &in]() {return halt || in.closed || !in.batches.empty();});
+	      if(halt || in.batches.empty())
+		break;
+	      batch = in.batches.front();
+	      in.batches.pop_front();
+	    }
+
+	    if(!stages[stage](*batch)) {
+	      give_back(batch);
+	      break;
+	    }
+
+	    {
+	      std::lock_guard<std::mutex> lock(mutex);
+	      out.batches.push_back(batch);
+	    }
+	    cv.notify_all();
+	  }
+	}
+	catch(...) {
+	  std::lock_guard<std::mutex> lock(mutex);
+	  if(!error)
+	    error = std::current_exception();
+	}
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  out.closed = true;
+	}
+	cv.notify_all();
+      }
+
+    public:
+
+      /**
+       * This is a batch handed to the consumer. It is given back to
+       * the pipeline when the handle is destroyed (or released), so
+       * that the first stage can refill it. Handles must not outlive
+       * the pipeline.
+       */
+      class Batch {
+      private:
+
+	Pipeline* pipeline = nullptr;
+	BATCH*    batch    = nullptr;
+
+	friend class Pipeline;
+	Batch(Pipeline* pipeline, BATCH* batch) : pipeline(pipeline), batch(batch) {}
+
+      public:
+
+	Batch()                        = default;
+	Batch(const Batch&)            = delete;
+	Batch& operator=(const Batch&) = delete;
+	Batch(Batch&& other) : pipeline(other.pipeline), batch(other.batch) {other.batch = nullptr;}
+	Batch& operator=(Batch&& other) {
+	  if(this != &other) {
+	    release();
+	    pipeline    = other.pipeline;
+	    batch       = other.batch;
+	    other.batch = nullptr;
+	  }
+	  return *this;
+	}
+	~Batch() {release();}
+
+	/** This gives the batch back to the pipeline. */
+	void release() {
+	  if(batch != nullptr)
+	    pipeline->give_back(batch);
+	  batch = nullptr;
+	}
+
+	/** @return false when the pipeline has no more batches. */
+	explicit operator bool() const {return batch != nullptr;}
+	BATCH& operator*()  const {return *batch;}
+	BATCH* operator->() const {return batch;}
+      };
+
+      /**
+       * @param nb_buffers The number of batches in the pipeline, 2 for double buffering. With more stages, more buffers let each stage work on its own batch.
+       * @param init The initial value of the buffers.
+       */
+      Pipeline(std::size_t nb_buffers, const BATCH& init = BATCH()) : buffers(nb_buffers, init), stages(), queues(), threads(), mutex(), cv() {
+	if(nb_buffers == 0)
+	  throw std::runtime_error("vq3::pipeline::Pipeline : at least one buffer is required.");
+      }
+
+      Pipeline()                           = delete;
+      Pipeline(const Pipeline&)            = delete;
+      Pipeline& operator=(const Pipeline&) = delete;
+
+      /**
+       * The stage threads are stopped, the pending batches are discarded.
+       */
+      ~Pipeline() {
+	{
+	  std::lock_guard<std::mutex> lock(mutex);
+	  halt = true;
+	}
+	cv.notify_all();
+	for(auto& t : threads) t.join();
+      }
+
+      /**
+       * This adds a stage, stages are run in the order they are added. The first stage fills a batch (it is given a batch from a previous round, e.g. a vector to be cleared), the next ones modify it.
+       * @param stage stage(batch) processes the batch. It may return a bool, false meaning that there are no more batches (the batch is then discarded).
+       */
+      template<typename STAGE>
+      Pipeline& operator<<(STAGE stage) {
+	if(!threads.empty())
+	  throw std::runtime_error("vq3::pipeline::Pipeline::operator<< : the pipeline is already started.");
+	if constexpr (std::is_void_v<std::invoke_result_t<STAGE&, BATCH&>>)
+	  stages.push_back([stage](BATCH& batch) mutable {stage(batch); return true;});
+	else
+	  stages.push_back([stage](BATCH& batch) mutable -> bool {return stage(batch);});
+	return *this;
+      }
+
+      /**
+       * This launches the stages, it is called by the first call to next().
+       */
+      void start() {
+	if(!threads.empty())
+	  return;
+	if(stages.empty())
+	  throw std::runtime_error("vq3::pipeline::Pipeline::start : no stage.");
+	queues = std::vector<Queue>(stages.size() + 1);
+	for(auto& b : buffers)
+	  queues[0].batches.push_back(&b);
+	for(std::size_t stage = 0; stage < stages.size(); ++stage)
+	  threads.emplace_back([this, stage]() {this->run(stage);});
+      }
+
+      /**
+       * This waits for the next batch that has gone through all the stages. If a stage has thrown an exception, it is rethrown here.
+       * @return The batch, that evaluates to false when there are no more batches.
+       */
+      Batch next() {
+	start();
+	auto& ready = queues.back();
+	std::unique_lock<std::mutex> lock(mutex);
+	cv.wait(lock, [this, &ready]() {return error || ready.closed || !ready.batches.empty();});
+	if(error)
+	  std::rethrow_exception(error);
+	if(ready.batches.empty())
+	  return Batch();
+	auto batch = ready.batches.front();
+	ready.batches.pop_front();
+	return Batch(this, batch);
+      }
+    };
+
+    /**
+     * @param nb_buffers The number of batches in the pipeline, 2 for double buffering.
+     */
+    template<typename BATCH>
+    Pipeline<BATCH> pipeline(std::size_t nb_buffers) {return Pipeline<BATCH>(nb_buffers);}
+  }
+}
@@ -0,0 +1,507 @@
+/*
+ *   Copyright (C) 2018,  CentraleSupelec
+ *
+ *   Author : Hervé Frezza-Buet
+ *
+ *   Contributor :
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public
+ *   License (GPL) as published by the Free Software Foundation; either
+ *   version 3 of the License, or any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *   General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *   Contact : herve.frezza-buet@centralesupelec.fr
+ *
+ */
+
+
+
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <memory>
+#include <atomic>
+#include <stdexcept>
+
+#include <vq3Utils.hpp>
+
+namespace vq3 {
+
+  namespace concept {
+
+    /**
+     * A search object finds the best matching unit of a sample, as
+     * vq3::utils::closest does, but with its own strategy. It can be
+     * passed to the processors instead of the distance function.
+     */
+    struct Search {
+
+      /** This is mandatory, it tells that the type is a search object. */
+      using search_tag = void;
+
+      /**
+       * This is called by the processors at the beginning of an
+       * epoch, before the parallel computation. The table is up to
+       * date. The search object may have internal caches (mutable
+       * attributes) that are refreshed here.
+       */
+      template<typename TABLE>
+      void prepare(TABLE& table) const;
+
+      /**
+       * This is called concurrently by the threads of the processors.
+       * @param closest_distance_value returns by reference the distance (as computed by distance()) between the sample and the closest vertex.
+       * @return The index of the closest vertex in the table, if any.
+       */
+      template<typename TABLE, typename SAMPLE>
+      std::optional<typename TABLE::index_type> closest(TABLE& table, const SAMPLE& sample, double& closest_distance_value) const;
+
+      /**
+       * @return The actual distance function, comparing a vertex value and a sample.
+       */
+      auto& distance() const;
+    };
+  }
+
+  namespace search {
+
+    /** This tells wether T fits vq3::concept::Search or if it is a mere distance function. */
+    template<typename T, typename = void> struct is_search                                         : std::false_type {};
+    template<typename T>                  struct is_search<T, std::void_t<typename T::search_tag>> : std::true_type  {};
+
+    /**
+     * Processors call this before the parallel computation of an epoch.
+     * @param distance Either a distance function (nothing is done) or a search object (see vq3::concept::Search).
+     */
+    template<typename TABLE, typename DISTANCE>
+    void prepare(TABLE& table, const DISTANCE& distance) {
+      if constexpr (is_search<DISTANCE>::value)
+	distance.prepare(table);
+    }
+
+    /**
+     * Finds the closest vertex.
+     * @param table The topology table, it must be up to date.
+     * @param sample We want the vertex closest to this sample.
+     * @param distance Either a distance function, used as in vq3::utils::closest, or a search object (see vq3::concept::Search).
+     * @param closest_distance_value returns by reference the closest distance value.
+     * @return The index of the closest vertex, if any.
+     */
+    template<typename TABLE, typename SAMPLE, typename DISTANCE>
+    std::optional<typename TABLE::index_type> closest(TABLE& table, const SAMPLE& sample, const DISTANCE& distance, double& closest_distance_value) {
+      if constexpr (is_search<DISTANCE>::value)
+	return distance.closest(table, sample, closest_distance_value);
+      else {
+	auto ref_v = utils::closest(table.g, sample, distance, closest_distance_value);
+	if(ref_v == nullptr)
+	  return {};
+	return table(ref_v);
+      }
+    }
+
+    /**
+     * @return The distance function itself, or the one used by a search object.
+     */
+    template<typename DISTANCE>
+    auto& distance_of(const DISTANCE& distance) {
+      if constexpr (is_search<DISTANCE>::value)
+	return distance.distance();
+      else
+	return distance;
+    }
+
+    /**
+     * This is a Mahalanobis distance function. It relies on the
+     * vq3_online_covariance attribute of the vertex values (see
+     * vq3::decorator::online::covariance). The Cholesky factors are
+     * only computed when the covariances are updated, at the end of
+     * an epoch (see vq3::epoch::data::online::covariance), so the
+     * distance computation only costs a triangular substitution.
+     */
+    template<typename PROTOTYPE_COMPONENTS, typename SAMPLE_COMPONENTS>
+    struct Mahalanobis {
+      PROTOTYPE_COMPONENTS prototype_components;
+      SAMPLE_COMPONENTS    sample_components;
+
+      template<typename VERTEX_VALUE, typename SAMPLE>
+      double operator()(const VERTEX_VALUE& vertex_value, const SAMPLE& sample) const {
+	auto w = prototype_components(vertex_value);
+	auto x = sample_components(sample);
+	typename std::decay_t<decltype(vertex_value.vq3_online_covariance)>::vector_type deviation;
+	auto wit = w.begin();
+	auto xit = x.begin();
+	for(auto& d : deviation) d = *(xit++) - *(wit++);
+	return vertex_value.vq3_online_covariance.mahalanobis2(deviation);
+      }
+    };
+
+    /**
+     * This builds a Mahalanobis distance function. As long as a
+     * vertex has not received any covariance estimation, its
+     * covariance is the identity (i.e. the distance is the squared
+     * euclidean one).
+     * @param prototype_components prototype_components(vertex_value) returns the std::array<double, DIM> of the prototype components.
+     * @param sample_components sample_components(sample) returns the std::array<double, DIM> of the sample components.
+     */
+    template<typename PROTOTYPE_COMPONENTS, typename SAMPLE_COMPONENTS>
+    auto mahalanobis(const PROTOTYPE_COMPONENTS& prototype_components, const SAMPLE_COMPONENTS& sample_components) {
+      return Mahalanobis<std::decay_t<PROTOTYPE_COMPONENTS>, std::decay_t<SAMPLE_COMPONENTS>>{prototype_components, sample_components};
+    }
+
+    namespace reduced {
+
+      /**
+       * This search handles a reduced precision (SCALAR is float or
+       * std::int8_t) copy of the prototypes, stored contiguously. The
+       * BMU search scans that copy, and the few best candidates are
+       * re-ranked with the actual (full precision) distance.
+       *
+       * The copy is refreshed at the beginning of each epoch (see
+       * vq3::concept::Search), i.e. after the prototypes have been
+       * set by the previous one.
+       *
+       * With std::int8_t, each prototype is quantized with its own
+       * scale, and the approximated squared euclidean distance is
+       * computed from integer dot products.
+       */
+      template<typename SCALAR, typename DISTANCE, typename VERTEX_COMPONENTS, typename SAMPLE_COMPONENTS>
+      class Codebook {
+      private:
+
+	static_assert(std::is_same<SCALAR, float>::value || std::is_same<SCALAR, std::int8_t>::value,
+		      "vq3::search::reduced::Codebook : SCALAR must be float or std::int8_t.");
+
+	DISTANCE          dist;
+	VERTEX_COMPONENTS vertex_components;
+	SAMPLE_COMPONENTS sample_components;
+	unsigned int      nb_candidates;
+
+	mutable std::size_t         dim     = 0;
+	mutable std::size_t         nb_rows = 0;
+	mutable std::vector<SCALAR> rows;   // rows[idx*dim + k] is the k^th component of prototype #idx.
+	mutable std::vector<double> scales; // int8 only : rows[idx*dim + k]*scales[idx] is the k^th component of prototype #idx.
+	mutable std::vector<double> norms2; // int8 only : the full precision squared norm of prototype #idx.
+
+	// This appends to out the reduced version of the components. It returns the squared norm, and sets the scale.
+	template<typename COMPONENTS>
+	static double reduce(const COMPONENTS& components, std::vector<SCALAR>& out, double& scale) {
+	  double norm2 = 0;
+	  scale        = 1;
+	  if constexpr (std::is_same<SCALAR, float>::value)
+	    for(auto c : components) {
+	      out.push_back((float)c);
+	      norm2 += c*c;
+	    }
+	  else {
+	    double max_abs = 0;
+	    for(auto c : components) {
+	      max_abs = std::max(max_abs, std::fabs((double)c));
+	      norm2  += c*c;
+	    }
+	    if(max_abs > 0)
+	      scale = max_abs/127.0;
+	    for(auto c : components)
+	      out.push_back((std::int8_t)(std::lround(c/scale)));
+	  }
+	  return norm2;
+	}
+
+      public:
+
+	using search_tag = void;
+
+	Codebook(const DISTANCE& distance, const VERTEX_COMPONENTS& vertex_components, const SAMPLE_COMPONENTS& sample_components, unsigned int nb_candidates)
+	  : dist(distance), vertex_components(vertex_components), sample_components(sample_components), nb_candidates(std::max(nb_candidates, (unsigned int)1)) {}
+	Codebook()                           = delete;
+	Codebook(const Codebook&)            = default;
+	Codebook(Codebook&&)                 = default;
+	Codebook& operator=(const Codebook&) = default;
+	Codebook& operator=(Codebook&&)      = default;
+
+	const DISTANCE& distance() const {return dist;}
+
+	/**
+	 * This rebuilds the reduced copy of the prototypes, from the vertices in the table.
+	 */
+	template<typename TABLE>
+	void prepare(TABLE& table) const {
+	  rows.clear();
+	  scales.clear();
+	  norms2.clear();
+	  nb_rows = table.size();
+	  dim     = 0;
+	  for(typename TABLE::index_type idx = 0; idx < nb_rows; ++idx) {
+	    double scale;
+	    double norm2 = reduce(vertex_components((*(table(idx)))()), rows, scale);
+	    if(idx == 0) {
+	      dim = rows.size();
+	      rows.reserve(dim*nb_rows);
+	    }
+	    if constexpr (std::is_same<SCALAR, std::int8_t>::value) {
+	      scales.push_back(scale);
+	      norms2.push_back(norm2);
+	    }
+	  }
+	}
+
+	/**
+	 * This finds the closest vertex (see vq3::concept::Search).
+	 */
+	template<typename TABLE, typename SAMPLE>
+	std::optional<typename TABLE::index_type> closest(TABLE& table, const SAMPLE& sample, double& closest_distance_value) const {
+	  using index_type = typename TABLE::index_type;
+
+	  closest_distance_value = std::numeric_limits<double>::max();
+	  if(nb_rows == 0)
+	    return {};
+
+	  // Buffers are kept alive by each thread between two calls.
+	  thread_local std::vector<SCALAR> s;
+	  thread_local std::vector<std::pair<double, index_type>> candidates; // sorted by increasing approximated distance.
+
+	  s.clear();
+	  double s_scale;
+	  double s_norm2 = reduce(sample_components(sample), s, s_scale);
+	  candidates.clear();
+
+	  auto row = rows.begin();
+	  for(index_type idx = 0; idx < nb_rows; ++idx, row += dim) {
+	    double d;
+	    if constexpr (std::is_same<SCALAR, float>::value) {
+	      float acc = 0;
+	      auto  sit = s.begin();
+	      for(auto it = row, end = row + dim; it != end; ++it, ++sit) {
+		float diff = *it - *sit;
+		acc += diff*diff;
+	      }
+	      d = acc;
+	    }
+	    else {
+	      std::int32_t acc = 0;
+	      auto  sit = s.begin();
+	      for(auto it = row, end = row + dim; it != end; ++it, ++sit)
+		acc += (std::int32_t)(*it) * (std::int32_t)(*sit);
+	      d = s_norm2 - 2*s_scale*scales[idx]*acc + norms2[idx];
+	    }
+
+	    if(candidates.size() < nb_candidates || d < candidates.back().first) {
+	      if(candidates.size() == nb_candidates)
+		candidates.pop_back();
+	      auto pos = std::upper_bound(candidates.begin(), candidates.end(), d,
+					  [](double d, const std::pair<double, index_type>& c) {return d < c.first;});
+	      candidates.insert(pos, {d, idx});
+	    }
+	  }
+
+	  // Candidates are re-ranked with the actual distance.
+	  index_type res = candidates.front().second;
+	  for(auto& c : candidates)
+	    if(double d = dist((*(table(c.second)))(), sample); d < closest_distance_value) {
+	      closest_distance_value = d;
+	      res = c.second;
+	    }
+	  return res;
+	}
+      };
+
+      /**
+       * This builds a float32 search object.
+       * @param distance distance(vertex_value, sample) is the actual distance, used for re-ranking.
+       * @param vertex_components vertex_components(vertex_value) returns the (iterable) collection of the prototype components.
+       * @param sample_components sample_components(sample) returns the (iterable) collection of the sample components.
+       * @param nb_candidates The number of best candidates that are re-ranked with the actual distance.
+       */
+      template<typename DISTANCE, typename VERTEX_COMPONENTS, typename SAMPLE_COMPONENTS>
+      auto float32(const DISTANCE& distance, const VERTEX_COMPONENTS& vertex_components, const SAMPLE_COMPONENTS& sample_components, unsigned int nb_candidates = 2) {
+	return Codebook<float, std::decay_t<DISTANCE>, std::decay_t<VERTEX_COMPONENTS>, std::decay_t<SAMPLE_COMPONENTS>>(distance, vertex_components, sample_components, nb_candidates);
+      }
+
+      /**
+       * This builds an int8 search object.
+       * @param distance distance(vertex_value, sample) is the actual distance, used for re-ranking.
+       * @param vertex_components vertex_components(vertex_value) returns the (iterable) collection of the prototype components.
+       * @param sample_components sample_components(sample) returns the (iterable) collection of the sample components.
+       * @param nb_candidates The number of best candidates that are re-ranked with the actual distance.
+       */
+      template<typename DISTANCE, typename VERTEX_COMPONENTS, typename SAMPLE_COMPONENTS>
+      auto int8(const DISTANCE& distance, const VERTEX_COMPONENTS& vertex_components, const SAMPLE_COMPONENTS& sample_components, unsigned int nb_candidates = 2) {
+	return Codebook<std::int8_t, std::decay_t<DISTANCE>, std::decay_t<VERTEX_COMPONENTS>, std::decay_t<SAMPLE_COMPONENTS>>(distance, vertex_components, sample_components, nb_candidates);
+      }
+    }
+
+    namespace grid {
+
+      /**
+       * This search is dedicated to SOMs whose vertices are
+       * decorated with vq3::decorator::grid_pos (e.g. built with
+       * vq3::utils::make_grid and set with their grid position). For
+       * an organized map, close vertices in the grid have close
+       * prototypes, so the search is hierarchical. A coarse grid,
+       * made of one vertex every stride positions, is scanned
+       * first. Then, the search is exhaustive within a window around
+       * the few best coarse vertices.
+       *
+       * If verify is set, the exact BMU (linear scan) is computed as
+       * well and it is returned if it differs from the coarse-to-fine
+       * result. nb_corrections() counts such situations, which helps
+       * to tune the stride and the window radius.
+       */
+      template<typename DISTANCE>
+      class CoarseToFine {
+      public:
+
+	static constexpr std::size_t no_index = std::numeric_limits<std::size_t>::max();
+
+      private:
+
+	DISTANCE     dist;
+	unsigned int stride;
+	unsigned int radius;
+	unsigned int nb_coarse;
+	bool         verify;
+	std::shared_ptr<std::atomic<std::size_t>> corrections;
+
+	mutable unsigned int             width  = 0;
+	mutable unsigned int             height = 0;
+	mutable std::vector<std::size_t> cells;  // cells[h*width + w] is the index of the vertex at (w, h), or no_index.
+	mutable std::vector<std::size_t> coarse; // The indices of the coarse grid vertices.
+
+      public:
+
+	using search_tag = void;
+
+	CoarseToFine(const DISTANCE& distance, unsigned int stride, unsigned int radius, unsigned int nb_coarse, bool verify)
+	  : dist(distance), stride(std::max(stride, (unsigned int)1)), radius(radius), nb_coarse(std::max(nb_coarse, (unsigned int)1)), verify(verify),
+	    corrections(std::make_shared<std::atomic<std::size_t>>(0)) {}
+	CoarseToFine()                               = delete;
+	CoarseToFine(const CoarseToFine&)            = default;
+	CoarseToFine(CoarseToFine&&)                 = default;
+	CoarseToFine& operator=(const CoarseToFine&) = default;
+	CoarseToFine& operator=(CoarseToFine&&)      = default;
+
+	const DISTANCE& distance() const {return dist;}
+
+	/**
+	 * @return the number of times the exact BMU differed from the coarse-to-fine one (verify mode only).
+	 */
+	std::size_t nb_corrections() const {return *corrections;}
+
+	/**
+	 * This maps the grid positions to the table indices, and selects the coarse grid vertices.
+	 */
+	template<typename TABLE>
+	void prepare(TABLE& table) const {
+	  width  = 0;
+	  height = 0;
+	  for(typename TABLE::index_type idx = 0; idx < table.size(); ++idx) {
+	    auto& pos = (*(table(idx)))().vq3_gridpos;
+	    width  = std::max(width,  pos.first  + 1);
+	    height = std::max(height, pos.second + 1);
+	  }
+
+	  cells.assign(width*height, no_index);
+	  for(typename TABLE::index_type idx = 0; idx < table.size(); ++idx) {
+	    auto& pos = (*(table(idx)))().vq3_gridpos;
+	    auto& cell = cells[pos.second*width + pos.first];
+	    if(cell != no_index)
+	      throw std::runtime_error("vq3::search::grid::CoarseToFine::prepare : several vertices share the same grid position.");
+	    cell = idx;
+	  }
+
+	  coarse.clear();
+	  for(unsigned int h = std::min(stride/2, height - 1); h < height; h += stride)
+	    for(unsigned int w = std::min(stride/2, width - 1); w < width; w += stride)
+	      if(auto idx = cells[h*width + w]; idx != no_index)
+		coarse.push_back(idx);
+	}
+
+	/**
+	 * This finds the closest vertex (see vq3::concept::Search).
+	 */
+	template<typename TABLE, typename SAMPLE>
+	std::optional<typename TABLE::index_type> closest(TABLE& table, const SAMPLE& sample, double& closest_distance_value) const {
+	  using index_type = typename TABLE::index_type;
+
+	  closest_distance_value = std::numeric_limits<double>::max();
+	  if(coarse.size() == 0)
+	    return {};
+
+	  thread_local std::vector<std::pair<double, std::size_t>> candidates; // sorted by increasing distance.
+	  candidates.clear();
+	  for(auto idx : coarse) {
+	    double d = dist((*(table(idx)))(), sample);
+	    if(candidates.size() < nb_coarse || d < candidates.back().first) {
+	      if(candidates.size() == nb_coarse)
+		candidates.pop_back();
+	      auto pos = std::upper_bound(candidates.begin(), candidates.end(), d,
+					  [](double d, const std::pair<double, std::size_t>& c) {return d < c.first;});
+	      candidates.insert(pos, {d, idx});
+	    }
+	  }
+
+	  // Windows may overlap, the few vertices evaluated twice do not change the result.
+	  std::size_t res = candidates.front().second;
+	  closest_distance_value = candidates.front().first;
+	  for(auto& c : candidates) {
+	    auto& pos = (*(table(c.second)))().vq3_gridpos;
+	    unsigned int wmin = pos.first  > radius ? pos.first  - radius : 0;
+	    unsigned int hmin = pos.second > radius ? pos.second - radius : 0;
+	    unsigned int wmax = std::min(pos.first  + radius + 1, width);
+	    unsigned int hmax = std::min(pos.second + radius + 1, height);
+	    for(unsigned int h = hmin; h < hmax; ++h)
+	      for(unsigned int w = wmin; w < wmax; ++w)
+		if(auto idx = cells[h*width + w]; idx != no_index)
+		  if(double d = dist((*(table(idx)))(), sample); d < closest_distance_value) {
+		    closest_distance_value = d;
+		    res = idx;
+		  }
+	  }
+
+	  if(verify) {
+	    bool corrected = false;
+	    for(index_type idx = 0; idx < table.size(); ++idx)
+	      if(double d = dist((*(table(idx)))(), sample); d < closest_distance_value) {
+		closest_distance_value = d;
+		res = idx;
+		corrected = true;
+	      }
+	    if(corrected)
+	      ++(*corrections);
+	  }
+
+	  return (index_type)res;
+	}
+      };
+
+      /**
+       * This builds a coarse-to-fine search object for SOM grids.
+       * @param distance distance(vertex_value, sample) is the distance.
+       * @param stride The coarse grid keeps one vertex every stride positions, in both directions.
+       * @param radius The exhaustive search is performed in a (2*radius+1)x(2*radius+1) window around the coarse winners. radius = stride is a safe choice.
+       * @param nb_coarse The number of best coarse vertices whose window is explored.
+       * @param verify If true, the exact BMU is computed as well and it is used in case of mismatch.
+       */
+      template<typename DISTANCE>
+      auto coarse_to_fine(const DISTANCE& distance, unsigned int stride, unsigned int radius, unsigned int nb_coarse = 2, bool verify = false) {
+	return CoarseToFine<std::decay_t<DISTANCE>>(distance, stride, radius, nb_coarse, verify);
+      }
+    }
+  }
+}
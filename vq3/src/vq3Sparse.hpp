@@ -0,0 +1,341 @@
+/*
+ *   Copyright (C) 2018,  CentraleSupelec
+ *
+ *   Author : Hervé Frezza-Buet
+ *
+ *   Contributor :
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public
+ *   License (GPL) as published by the Free Software Foundation; either
+ *   version 3 of the License, or any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ *   General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ *   Contact : herve.frezza-buet@centralesupelec.fr
+ *
+ */
+
+
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+#include <cstddef>
+#include <iostream>
+
+#include <vq3Utils.hpp>
+
+namespace vq3 {
+  namespace sparse {
+
+    /**
+     * This is a sparse vector, used for samples. It stores the
+     * non-null (index, value) components, sorted by increasing index,
+     * and its squared norm that is computed once at construction.
+     */
+    class Vector {
+    public:
+
+      using entry_type = std::pair<unsigned int, double>;
+
+    private:
+
+      std::size_t             dim = 0;
+      std::vector<entry_type> entries;
+      double                  n2  = 0;
+
+      friend std::ostream& operator<<(std::ostream& os, const Vector& v) {
+	os << '[' << v.dim << " :";
+	for(auto& e : v.entries)
+	  os << ' ' << e.first << ':' << e.second;
+	os << ']';
+	return os;
+      }
+
+    public:
+
+      Vector()                         = default;
+      Vector(const Vector&)            = default;
+      Vector(Vector&&)                 = default;
+      Vector& operator=(const Vector&) = default;
+      Vector& operator=(Vector&&)      = default;
+
+      /**
+       * @param dim The dimension of the vector.
+       * @param begin, end A collection of (index, value) pairs. They are sorted, values with the same index are summed, and null values are ignored.
+       */
+      template<typename ITER>
+      Vector(std::size_t dim, const ITER& begin, const ITER& end) : dim(dim), entries(), n2(0) {
+	for(auto it = begin; it != end; ++it)
+	  if(it->second != 0) {
+	    if(it->first >= dim) {
+	      std::ostringstream ostr;
+	      ostr << "vq3::sparse::Vector : index " << it->first << " out of range (dim = " << dim << ").";
+	      throw std::runtime_error(ostr.str());
+	    }
+	    entries.emplace_back(it->first, it->second);
+	  }
+	std::sort(entries.begin(), entries.end(),
+		  [](const entry_type& a, const entry_type& b) {return a.first < b.first;});
+	if(!entries.empty()) {
+	  auto last = entries.begin();
+	  for(auto it = last + 1; it != entries.end(); ++it)
+	    if(it->first == last->first)
+	      last->second += it->second;
+	    else
+	      *(++last) = *it;
+	  entries.erase(last + 1, entries.end());
+	  entries.erase(std::remove_if(entries.begin(), entries.end(), [](const entry_type& e) {return e.second == 0;}), entries.end());
+	}
+	for(auto& e : entries)
+	  n2 += e.second * e.second;
+      }
+
+      /**
+       * This builds a sparse vector from a dense collection of numbers.
+       */
+      template<typename DENSE_ITER>
+      static Vector from_dense(const DENSE_ITER& begin, const DENSE_ITER& end) {
+	std::vector<entry_type> e;
+	unsigned int idx = 0;
+	for(auto it = begin; it != end; ++it, ++idx)
+	  if(*it != 0)
+	    e.emplace_back(idx, *it);
+	return Vector(idx, e.begin(), e.end());
+      }
+
+      /** @return the dimension. */
+      std::size_t size()         const {return dim;}
+
+      /** @return the number of non-null components. */
+      std::size_t nb_non_zeros() const {return entries.size();}
+
+      /** @return the squared norm. */
+      double      norm2()        const {return n2;}
+
+      /** Iterates on the (index, value) non-null components. */
+      auto begin() const {return entries.begin();}
+      auto end()   const {return entries.end();}
+    };
+
+
+    /**
+     * This is a dense vector, used for prototypes. Its squared norm
+     * is cached, so components are read-only, and every operation
+     * producing a Dense value recomputes that norm once.
+     */
+    class Dense {
+    private:
+
+      std::vector<double> values;
+      double              n2 = 0;
+
+      void update_norm() {
+	n2 = 0;
+	for(auto v : values) n2 += v*v;
+      }
+
+      void check(std::size_t dim, const char* where) const {
+	if(values.size() != dim) {
+	  std::ostringstream ostr;
+	  ostr << "vq3::sparse::Dense::" << where << " : dimension mismatch (" << values.size() << " != " << dim << ").";
+	  throw std::runtime_error(ostr.str());
+	}
+      }
+
+      friend std::ostream& operator<<(std::ostream& os, const Dense& v) {
+	os << '[';
+	for(auto x : v.values)
+	  os << ' ' << x;
+	os << " ]";
+	return os;
+      }
+
+    public:
+
+      Dense()                        = default;
+      Dense(const Dense&)            = default;
+      Dense(Dense&&)                 = default;
+      Dense& operator=(const Dense&) = default;
+      Dense& operator=(Dense&&)      = default;
+
+      /** A null vector. */
+      explicit Dense(std::size_t dim) : values(dim, 0.0), n2(0) {}
+
+      /** Takes the components. */
+      explicit Dense(std::vector<double> components) : values(std::move(components)), n2(0) {update_norm();}
+
+      /** This expands a sparse vector. */
+      Dense(const Vector& v) : values(v.size(), 0.0), n2(v.norm2()) {
+	for(auto& e : v) values[e.first] = e.second;
+      }
+
+      std::size_t                size()       const {return values.size();}
+      double                     norm2()      const {return n2;}
+      double                     operator[](std::size_t i) const {return values[i];}
+      const std::vector<double>& components() const {return values;}
+      auto                       begin()      const {return values.begin();}
+      auto                       end()        const {return values.end();}
+
+      /** Sets the i^th component (the norm is updated in constant time). */
+      void set(std::size_t i, double v) {
+	n2 += v*v - values[i]*values[i];
+	values[i] = v;
+      }
+
+      Dense operator+(const Dense& other) const {
+	check(other.size(), "operator+");
+	Dense res(*this);
+	auto it = other.values.begin();
+	for(auto& v : res.values) v += *(it++);
+	res.update_norm();
+	return res;
+      }
+
+      Dense operator-(const Dense& other) const {
+	check(other.size(), "operator-");
+	Dense res(*this);
+	auto it = other.values.begin();
+	for(auto& v : res.values) v -= *(it++);
+	res.update_norm();
+	return res;
+      }
+
+      Dense operator*(double coef) const {
+	Dense res(*this);
+	for(auto& v : res.values) v *= coef;
+	res.n2 = n2*coef*coef;
+	return res;
+      }
+
+      Dense operator/(double coef) const {
+	return (*this) * (1/coef);
+      }
+
+      /** @return the dot product with a sparse vector, computed in O(nb_non_zeros). */
+      double dot(const Vector& x) const {
+	check(x.size(), "dot");
+	double res = 0;
+	for(auto& e : x) res += values[e.first] * e.second;
+	return res;
+      }
+    };
+
+    inline Dense operator*(double coef, const Dense& v) {return v * coef;}
+
+    /**
+     * The squared euclidean distance between a prototype and a
+     * sample. It is computed in O(nb_non_zeros) thanks to the cached
+     * squared norms : |w-x|^2 = |w|^2 - 2 w.x + |x|^2
+     */
+    inline double d2(const Dense& w, const Vector& x) {
+      return std::max(w.norm2() - 2*w.dot(x) + x.norm2(), 0.0);
+    }
+
+    /**
+     * The squared euclidean distance between two prototypes.
+     */
+    inline double d2(const Dense& w1, const Dense& w2) {
+      if(w1.size() != w2.size())
+	throw std::runtime_error("vq3::sparse::d2 : dimension mismatch.");
+      double res = 0;
+      auto it = w2.begin();
+      for(auto v : w1) {
+	double d = v - *(it++);
+	res += d*d;
+      }
+      return res;
+    }
+  }
+
+  namespace utils {
+
+    /**
+     * This accumulates sparse samples into a dense sum, so that
+     * vq3::epoch::data::wta and vq3::epoch::data::wtm handle sparse
+     * samples in O(nb_non_zeros). The average is a
+     * vq3::sparse::Dense, suitable for prototype setting.
+     */
+    template<typename NB_TYPE>
+    struct accum<vq3::sparse::Vector, NB_TYPE> {
+      NB_TYPE             nb;
+      std::vector<double> value;
+
+      accum(const accum&)             = default;
+      accum& operator=(const accum&)  = default;
+      accum(accum&&)                  = default;
+      accum& operator=(accum&&)       = default;
+
+      accum() : nb(0), value() {}
+
+      /**
+       * Returns the average. The template argument is the type for casting nb befor the division.
+       */
+      template<typename NB_AVG_TYPE = NB_TYPE>
+      vq3::sparse::Dense average() const {
+	auto res = value;
+	auto coef = 1/static_cast<NB_AVG_TYPE>(nb);
+	for(auto& v : res) v *= coef;
+	return vq3::sparse::Dense(std::move(res));
+      }
+
+      void clear() {
+	nb = 0;
+	value.clear();
+      }
+
+      /** nb = 1, value = v */
+      accum& operator=(const vq3::sparse::Vector& v) {
+	nb = 1;
+	value.assign(v.size(), 0.0);
+	for(auto& e : v) value[e.first] = e.second;
+	return *this;
+      }
+
+      /** nb += coef; value += coef*v; */
+      accum& increment(NB_TYPE coef, const vq3::sparse::Vector& v) {
+	nb += coef;
+	if(value.size() == 0)
+	  value.assign(v.size(), 0.0);
+	for(auto& e : v) value[e.first] += coef * e.second;
+	return *this;
+      }
+
+      /** nb += 1; value += v; */
+      accum& operator+=(const vq3::sparse::Vector& v) {
+	++nb;
+	if(value.size() == 0)
+	  value.assign(v.size(), 0.0);
+	for(auto& e : v) value[e.first] += e.second;
+	return *this;
+      }
+
+      /** nb += a.nb; value += a.value; */
+      accum& operator+=(const accum& a) {
+	nb += a.nb;
+	if(a.value.size() == 0)
+	  return *this;
+	if(value.size() == 0)
+	  value = a.value;
+	else {
+	  auto it = a.value.begin();
+	  for(auto& v : value) v += *(it++);
+	}
+	return *this;
+      }
+    };
+  }
+}
@@ -36,6 +36,8 @@
 #include <cmath>
 #include <utility>
 #include <tuple>
+#include <array>
+#include <cstddef>
 
 
 namespace vq3 {
@@ -330,6 +332,132 @@ namespace vq3 {
   
       template<typename VALUE, typename ONLINE_PARAM>
       MeanStd<VALUE, ONLINE_PARAM> mean_std(const ONLINE_PARAM& p) {return  MeanStd<VALUE, ONLINE_PARAM>(p);}
+
+
+      /**
+       * This computes a covariance matrix approximation thanks to a
+       * low-pass recursive filter, as vq3::stats::online::Mean does
+       * (the first matrix initializes the filter).
+       *
+       * \f$C_{n+1} = (1-\alpha)C_n + \alpha M_n \f$
+       *
+       * The Cholesky factor L (C = L.L^T) is recomputed at each
+       * update, so that Mahalanobis distances can then be computed
+       * without any matrix inversion. Matrices are DIMxDIM, stored
+       * row-major.
+       *
+       * The value of \f$\alpha \in [0,1] \f$ is given by ONLINE_PARAM, that must fit vq3::concept::OnlineParam
+       */
+      template<std::size_t DIM, typename ONLINE_PARAM>
+      class Covariance {
+      public:
+
+	static constexpr std::size_t dim = DIM;
+	using vector_type = std::array<double, DIM>;
+	using matrix_type = std::array<double, DIM*DIM>;
+
+      private:
+
+	ONLINE_PARAM param;
+	matrix_type  cov;
+	matrix_type  L;
+	bool         ok = false;
+	unsigned int nb = 0;
+
+	static matrix_type identity() {
+	  matrix_type res;
+	  res.fill(0);
+	  for(std::size_t i = 0; i < DIM; ++i) res[i*DIM + i] = 1;
+	  return res;
+	}
+
+	// Cholesky-Banachiewicz. Non positive pivots (degenerated
+	// covariances) are replaced by a tiny positive value.
+	void factorize() {
+	  double trace = 0;
+	  for(std::size_t i = 0; i < DIM; ++i) trace += cov[i*DIM + i];
+	  double eps = std::max(1e-10*trace/DIM, 1e-12);
+	  L.fill(0);
+	  for(std::size_t i = 0; i < DIM; ++i)
+	    for(std::size_t j = 0; j <= i; ++j) {
+	      double sum = cov[i*DIM + j];
+	      for(std::size_t k = 0; k < j; ++k) sum -= L[i*DIM + k] * L[j*DIM + k];
+	      if(i == j)
+		L[i*DIM + i] = std::sqrt(std::max(sum, eps));
+	      else
+		L[i*DIM + j] = sum / L[j*DIM + j];
+	    }
+	}
+
+      public:
+
+	Covariance() : param(), cov(identity()), L(identity()), ok(false), nb(0) {}
+	Covariance(const ONLINE_PARAM& p) : param(p), cov(identity()), L(identity()), ok(false), nb(0) {}
+	Covariance(const Covariance&)            = default;
+	Covariance& operator=(const Covariance&) = default;
+
+	/**
+	 * Clears and forget the previous matrices. The covariance is the identity.
+	 */
+	void clear() {
+	  ok  = false;
+	  nb  = 0;
+	  cov = identity();
+	  L   = identity();
+	}
+
+	/**
+	 * This enables to use an instance as a boolean, in order to test wether it is ready for providing a trustable value.
+	 */
+	operator bool() const {
+	  return ok;
+	}
+
+	/**
+	 * @returns an estimation of the covariance matrix.
+	 */
+	const matrix_type& covariance() const {return cov;}
+
+	/**
+	 * @returns the lower triangular Cholesky factor of the covariance matrix.
+	 */
+	const matrix_type& cholesky() const {return L;}
+
+	/**
+	 * This considers a new covariance matrix, and updates the factorization.
+	 */
+	Covariance& operator+=(const matrix_type& m) {
+	  if(nb == 0)
+	    cov = m;
+	  else {
+	    double alpha = param.alpha();
+	    auto it = m.begin();
+	    for(auto& c : cov) c += alpha*(*(it++) - c);
+	  }
+	  if(!(*this))
+	    ok = ++nb >= param.min_updates();
+	  else
+	    ++nb;
+	  factorize();
+	  return *this;
+	}
+
+	/**
+	 * @param deviation The difference between some vector and the mean.
+	 * @returns the squared Mahalanobis norm of the deviation. It costs a DIMxDIM forward substitution.
+	 */
+	double mahalanobis2(const vector_type& deviation) const {
+	  vector_type y;
+	  double res = 0;
+	  for(std::size_t i = 0; i < DIM; ++i) {
+	    double sum = deviation[i];
+	    for(std::size_t k = 0; k < i; ++k) sum -= L[i*DIM + k] * y[k];
+	    y[i] = sum / L[i*DIM + i];
+	    res += y[i]*y[i];
+	  }
+	  return res;
+	}
+      };
     }
         
     
@@ -31,27 +31,58 @@
 
 #include <list>
 #include <utility>
-#include <deque>
 #include <vector>
-#include <map>
 #include <iterator>
 #include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <future>
+#include <cstdlib>
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 
 #include <vq3Graph.hpp>
 #include <vq3Utils.hpp>
+#include <vq3Executor.hpp>
 
 namespace vq3 {
 
   namespace topology {
 
+    /**
+     * Each filling of a topology table gets a unique stamp, that
+     * identifies the vertex indices it sets (see
+     * vq3::vertex::set_table_index).
+     */
+    inline std::size_t new_table_stamp() {
+      static std::atomic<std::size_t> last_stamp(0);
+      return ++last_stamp;
+    }
+    
     /**
      * This builds a array of the vertex currently in the graph,
      * associating to each vertex an integer idf. Access to vertices
      * can be done from the index, and recipocally, the index of a
-     * vertex can be retrieved (log(n) complexity).
+     * vertex can be retrieved (constant complexity, since the index
+     * is stored in the vertex itself).
+     *
+     * If several tables are built from the same graph, the vertices
+     * store the index of the last filled one. The other tables then
+     * retrieve the index from a hash table, keyed by the vertex
+     * addresses, that they fill along with the vertices.
      *
-     * Table also hosts the computation of neighborhoods for each vertex.
+     * Table also hosts the computation of neighborhoods for each
+     * vertex. The hop distances found by the last computation are
+     * kept, so that recomputing the neighborhoods with another
+     * kernel (voed, max_dist, min_val) on an unchanged graph only
+     * costs a reweighting pass, as long as the kernel radius does not
+     * increase (e.g. SOM schedules, which shrink the neighborhoods).
      *
      * The graph vertices must be tag-decorated. 
      */
@@ -76,19 +107,128 @@ namespace vq3 {
 	Info& operator=(Info&&)      = default;
       };
 
-      using neighborhood_table_type = std::map<typename graph_type::ref_vertex, std::list<Info> >;
+      /**
+       * This is the packed neighborhood information stored in the
+       * neighborhood table.
+       */
+      struct Neighbour {
+	std::uint32_t index;
+	float         value;
+      };
+
+      /**
+       * This is a neighborhood from the neighborhood table. It is a
+       * contiguous range of Neighbour items, the first one is the
+       * origin vertex, the next ones are sorted by decreasing
+       * value. In lazy mode, the neighborhood shares the
+       * ownership of the items, so that it remains valid when it is
+       * evicted from the cache.
+       */
+      struct Neighborhood {
+	const Neighbour*                              first = nullptr;
+	const Neighbour*                              last  = nullptr;
+	std::shared_ptr<const std::vector<Neighbour>> owner;
+
+	const Neighbour* begin() const {return first;}
+	const Neighbour* end()   const {return last;}
+	std::size_t      size()  const {return last - first;}
+	bool             empty() const {return first == last;}
+      };
 
     private:
 
+      using job_type = std::pair<unsigned int, typename graph_type::ref_vertex>;
+
+      /**
+       * This marks the vertices visited by a breadth-first search on
+       * the vertex indices. Marks are stamped, so that they do not
+       * need to be cleared between two searches. Each thread has its
+       * own instance, so searches do not use the vertex tags.
+       */
+      class Visited {
+      private:
+
+	std::vector<std::uint32_t> marks;
+	std::uint32_t              current = 0;
+
+      public:
+
+	std::vector<std::pair<unsigned int, index_type>> to_do; // (distance, index) pairs.
+
+	void start(std::size_t nb_vertices) {
+	  to_do.clear();
+	  if(marks.size() != nb_vertices) {
+	    marks.assign(nb_vertices, 0);
+	    current = 0;
+	  }
+	  if(++current == 0) { // The stamp has wrapped.
+	    std::fill(marks.begin(), marks.end(), 0);
+	    current = 1;
+	  }
+	}
+
+	/** @return true if idx has not been visited yet, it is marked as visited then. */
+	bool visit(index_type idx) {
+	  auto& mark = marks[idx];
+	  if(mark == current)
+	    return false;
+	  mark = current;
+	  return true;
+	}
+      };
       
       std::vector<typename graph_type::ref_vertex> idx2vertex;
-      std::map<typename graph_type::vertex_type*, index_type> vertex2idx;
-      neighborhood_table_type neighborhood_table;
+      std::size_t                                  stamp = 0;
+      utils::FlatMap                               index_of_vertex; // The keys are the vertex addresses, in case the vertices store the index of another table.
+      std::vector<Neighbour>                       neighbours;    // All the neighborhoods, packed.
+      std::vector<Neighborhood>                    neighborhoods; // neighborhoods[idx] is a range in neighbours.
 
+      // This is the state of the graph when the neighborhoods have
+      // been computed. It enables incremental updates.
+      bool                                         nbh_ok = false;
+      std::vector<typename graph_type::ref_vertex> nbh_vertices;   // idx2vertex at that time.
+      std::vector<std::size_t>                     nbh_offsets;    // nbh_adjacency[nbh_offsets[idx]...nbh_offsets[idx+1]] ...
+      std::vector<index_type>                      nbh_adjacency;  // ... are the sorted indices of the direct neighbours of vertex #idx.
+      std::vector<double>                          nbh_weights;    // The kernel (see kernel).
+      double                                       nbh_mass = 1;   // The cutoff mass (see cutoff).
+      double                                       mass     = 1;   // The cutoff mass for the next computations.
 
+      // For each vertex, the vertices at most hop_radius edges away,
+      // in breadth-first order, for the topology recorded above.
+      struct Hop {
+	std::uint32_t index;
+	std::uint32_t dist;
+      };
+      bool                                         hops_ok    = false;
+      unsigned int                                 hop_radius = 0;
+      std::vector<std::size_t>                     hop_offsets;
+      std::vector<Hop>                             hops;
 
+      // This is the bounded cache of the lazy mode (see lazy).
+      struct Lazy {
+	using items_type = std::shared_ptr<const std::vector<Neighbour>>;
+	using lru_type   = std::list<index_type>;
 
-      
+	std::size_t                                                                         capacity;
+	std::mutex                                                                          mutex;
+	lru_type                                                                            lru;   // The cached vertices, the most recently used first.
+	std::unordered_map<index_type, std::pair<items_type, typename lru_type::iterator>> cache;
+	std::vector<std::unique_ptr<Visited>>                                               visited_pool;
+
+	Lazy(std::size_t capacity) : capacity(capacity), mutex(), lru(), cache(), visited_pool() {}
+
+	void shrink() {
+	  if(capacity == 0)
+	    return;
+	  while(cache.size() > capacity) {
+	    cache.erase(lru.back());
+	    lru.pop_back();
+	  }
+	}
+      };
+      std::unique_ptr<Lazy>                        lazy_state; // nullptr when the whole table is computed.
+
+      static constexpr index_type no_index = std::numeric_limits<index_type>::max();
 
       friend std::ostream& operator<<(std::ostream& os, Table<graph_type>& v) {
 	os << "Vertex map : " << std::endl;
@@ -103,18 +243,25 @@ namespace vq3 {
        */
       void clear_vertices() {
 	idx2vertex.clear();
-	vertex2idx.clear();
+	index_of_vertex.clear();
       }
 
       /**
        * Fills or refills the table from the graph. It is called in the constructor.
        */
       void fill_vertices() {
+	stamp = new_table_stamp();
 	g.foreach_vertex([this](const typename graph_type::ref_vertex& ref_v) {
 	    auto idx = this->idx2vertex.size();
 	    this->idx2vertex.push_back(ref_v);
-	    this->vertex2idx[ref_v.get()] = idx;
+	    ref_v->set_table_index(this->stamp, idx);
 	  });
+	if(idx2vertex.size() > std::numeric_limits<std::uint32_t>::max())
+	  throw std::runtime_error("vq3::topology::Table::fill_vertices : too many vertices.");
+	index_of_vertex.reserve(idx2vertex.size());
+	std::uint32_t idx = 0;
+	for(auto& ref_v : idx2vertex)
+	  index_of_vertex.insert(reinterpret_cast<std::uintptr_t>(ref_v.get()), idx++);
       }
 
       /**
@@ -128,53 +275,394 @@ namespace vq3 {
       template<typename VALUE_OF_EDGE_DISTANCE>
       auto edge_based_neighborhood(index_type vertex_index, const typename graph_type::ref_vertex& ref_v, const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
 	std::list<Info> res;
-	std::deque<std::pair<unsigned int, typename graph_type::ref_vertex> > to_do;
+	std::vector<job_type> to_do;
 
-	auto res_out = std::back_inserter(res);
-	auto job_out = std::back_inserter(to_do);
-	*(res_out++) = {(double)(voed(0)), vertex_index};
+	res.emplace_back((double)(voed(0)), vertex_index);
 	(*ref_v)().vq3_tag = true;
-	ref_v->foreach_edge([&job_out, &ref_v](const typename graph_type::ref_edge ref_e) {
+	ref_v->foreach_edge([&to_do, &ref_v](const typename graph_type::ref_edge ref_e) {
 	    auto extr = ref_e->extremities();
 	    if(invalid_extremities(extr)) {ref_e->kill(); return;}
 	    auto& other = other_extremity(extr, ref_v);
 	    (*other)().vq3_tag = true;
-	    *(job_out++) = {1, other};
+	    to_do.emplace_back(1, other);
 	  });
 
-	while(!(to_do.empty())) {
-	  auto d_v = to_do.front();
-	  to_do.pop_front();
+	// to_do is a queue whose elements are never removed.
+	for(std::size_t head = 0; head < to_do.size(); ++head) {
+	  auto d_v = to_do[head];
 	  double val = voed(d_v.first);
 	  if(val > min_val) {
-	    *(res_out++) = {val, (*this)(d_v.second)};
+	    res.emplace_back(val, (*this)(d_v.second));
 	    if(d_v.first != max_dist)
-	      d_v.second->foreach_edge([&job_out, &v = d_v.second, dist = d_v.first + 1](const typename graph_type::ref_edge ref_e) {
+	      d_v.second->foreach_edge([&to_do, &v = d_v.second, dist = d_v.first + 1](const typename graph_type::ref_edge ref_e) {
 		  auto extr = ref_e->extremities();
 		  if(invalid_extremities(extr)) {ref_e->kill(); return;}
 		  auto& other = other_extremity(extr, v);
 		  auto& tag = (*other)().vq3_tag;
 		  if(!tag) {
 		    tag = true;
-		    *(job_out++) = {dist, other};
+		    to_do.emplace_back(dist, other);
 		  }
 		});
 	  }
 	}
 	return res;
       }
-      
+
       /**
-       * This builds a std::map, keys are ref_vertex type, values are
-       * the neighborhood returned by the neighborhood method.
+       * This records the edges of the graph, as sorted vertex indices
+       * for each vertex. Edges with killed extremities are killed.
+       */
+      void make_adjacency(std::vector<std::size_t>& offsets, std::vector<index_type>& adjacency) {
+	offsets.clear();
+	adjacency.clear();
+	offsets.push_back(0);
+	for(auto& ref_v : idx2vertex) {
+	  auto first = adjacency.size();
+	  ref_v->foreach_edge([this, &ref_v, &adjacency](const typename graph_type::ref_edge ref_e) {
+	      auto extr = ref_e->extremities();
+	      if(invalid_extremities(extr)) {ref_e->kill(); return;}
+	      adjacency.push_back((*this)(other_extremity(extr, ref_v)));
+	    });
+	  std::sort(adjacency.begin() + first, adjacency.end());
+	  offsets.push_back(adjacency.size());
+	}
+      }
+
+      /**
+       * This computes the kernel, i.e. the value of each edge
+       * distance. The neighborhoods contain all the vertices up to
+       * the kernel radius (its size minus 1), since the
+       * breadth-first search stops at the first distance whose value
+       * is not greater than min_val.
        */
       template<typename VALUE_OF_EDGE_DISTANCE>
-      void make_neighborhood_table(const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
-	neighborhood_table =  utils::make_vertex_table(g,
-						       [this, &voed, max_dist, min_val](const typename graph_type::ref_vertex& ref_v) {
-							 utils::clear_vertex_tags(g, false); 
-							 return neighborhood(ref_v, voed, max_dist, min_val); 
-						       });
+      std::vector<double> kernel(const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) const {
+	std::vector<double> weights;
+	weights.push_back((double)(voed(0)));
+	for(unsigned int d = 1; d < idx2vertex.size() && (max_dist == 0 || d <= max_dist); ++d) {
+	  double val = voed(d);
+	  if(val <= min_val)
+	    break;
+	  weights.push_back(val);
+	}
+	return weights;
+      }
+
+      /**
+       * This is the breadth-first search of the vertices at most
+       * radius edges away from vertex #vertex_index, performed on the
+       * recorded adjacency (see make_adjacency). It neither modifies
+       * the graph nor the table, so it can be run concurrently with
+       * distinct visited instances. out(index, dist) is called for
+       * each vertex found, in the breadth-first order (the origin
+       * vertex first).
+       */
+      template<typename OUT>
+      void search_hops(index_type vertex_index, unsigned int radius, Visited& visited, const OUT& out) const {
+	auto& to_do = visited.to_do;
+	auto expand = [this, &visited, &to_do](index_type idx, unsigned int dist) {
+	  for(auto it = nbh_adjacency.begin() + nbh_offsets[idx], end = nbh_adjacency.begin() + nbh_offsets[idx + 1]; it != end; ++it)
+	    if(visited.visit(*it))
+	      to_do.emplace_back(dist, *it);
+	};
+
+	visited.start(idx2vertex.size());
+	out(vertex_index, 0);
+	visited.visit(vertex_index);
+	if(radius > 0)
+	  expand(vertex_index, 1);
+
+	// to_do is a queue whose elements are never removed.
+	for(std::size_t head = 0; head < to_do.size(); ++head) {
+	  auto d_i = to_do[head];
+	  out(d_i.second, d_i.first);
+	  if(d_i.first < radius)
+	    expand(d_i.second, d_i.first + 1);
+	}
+      }
+
+      /**
+       * The neighborhood is packed[first...]. The neighbours
+       * following the origin vertex are sorted by decreasing value,
+       * and the neighborhood is truncated to the shortest prefix whose
+       * values sum to mass times the total.
+       */
+      void sort_and_truncate(std::vector<Neighbour>& packed, std::size_t first) const {
+	auto begin = packed.begin() + first;
+	if(begin == packed.end())
+	  return;
+	auto by_value = [](const Neighbour& a, const Neighbour& b) {return a.value > b.value;};
+	if(!std::is_sorted(begin + 1, packed.end(), by_value))
+	  std::stable_sort(begin + 1, packed.end(), by_value);
+	if(mass >= 1)
+	  return;
+
+	double total = 0;
+	for(auto it = begin; it != packed.end(); ++it)
+	  total += it->value;
+	double cumul = 0;
+	double limit = mass * total;
+	for(auto it = begin; it != packed.end(); ++it)
+	  if((cumul += it->value) >= limit) {
+	    packed.erase(it + 1, packed.end());
+	    return;
+	  }
+      }
+
+      // This appends the neighborhood of vertex #idx to packed.
+      void pack_neighborhood(index_type idx, const std::vector<double>& weights, Visited& visited, std::vector<Neighbour>& packed) const {
+	auto first = packed.size();
+	search_hops(idx, weights.size() - 1, visited,
+		    [&packed, &weights](index_type index, unsigned int dist) {packed.push_back({(std::uint32_t)index, (float)(weights[dist])});});
+	sort_and_truncate(packed, first);
+      }
+
+      // This appends the vertices at most radius edges away from vertex #idx to packed.
+      void pack_hops(index_type idx, unsigned int radius, Visited& visited, std::vector<Hop>& packed) const {
+	search_hops(idx, radius, visited,
+		    [&packed](index_type index, unsigned int dist) {packed.push_back({(std::uint32_t)index, (std::uint32_t)dist});});
+      }
+
+      void check_index_range() const {
+	if(idx2vertex.size() > std::numeric_limits<std::uint32_t>::max())
+	  throw std::runtime_error("vq3::topology::Table : too many vertices for 32-bit indices.");
+      }
+
+      /**
+       * This packs, for each vertex, the items computed by
+       * pack(idx, visited, packed), which appends them to packed. The
+       * vertices are split into executor.size() contiguous ranges,
+       * each job packs the items of its range, and the packs are
+       * concatenated. offsets[idx] is the position of the items of
+       * vertex #idx.
+       */
+      template<typename EXECUTOR, typename ITEM, typename PACK>
+      void pack_all(EXECUTOR& executor, std::vector<ITEM>& items, std::vector<std::size_t>& offsets, const PACK& pack) const {
+	unsigned int nb_threads = executor.size();
+	auto nb_vertices = idx2vertex.size();
+	offsets.assign(nb_vertices + 1, 0);
+	items.clear();
+
+	if(nb_threads <= 1 || nb_vertices < 2*nb_threads) {
+	  Visited visited;
+	  for(index_type idx = 0; idx < nb_vertices; ++idx) {
+	    pack(idx, visited, items);
+	    offsets[idx + 1] = items.size();
+	  }
+	  return;
+	}
+
+	auto iters = utils::split(idx2vertex.begin(), idx2vertex.end(), nb_threads);
+	std::vector<std::vector<ITEM>> packs(iters.size());
+	std::vector<std::future<void>> futures;
+	auto out = std::back_inserter(futures);
+	auto pit = packs.begin();
+	  
+	for(auto& begin_end : iters)
+	  *(out++) = executor.async([this, begin = (index_type)(std::distance(idx2vertex.begin(), begin_end.first)), end = (index_type)(std::distance(idx2vertex.begin(), begin_end.second)),
+				     &pack, &offsets, &packed = *(pit++)]() {
+				      Visited visited;
+				      for(index_type idx = begin; idx < end; ++idx) {
+					auto before = packed.size();
+					pack(idx, visited, packed);
+					offsets[idx + 1] = packed.size() - before; // Sizes for now.
+				      }
+				    });
+
+	vq3::executor::wait(futures); // All the jobs are over before an exception, if any, is rethrown.
+	for(index_type idx = 0; idx < nb_vertices; ++idx)
+	  offsets[idx + 1] += offsets[idx];
+	items.reserve(offsets.back());
+	for(auto& packed : packs)
+	  std::copy(packed.begin(), packed.end(), std::back_inserter(items));
+      }
+
+      // This sets the neighborhood ranges, and records the current vertices and kernel.
+      void finish_neighborhood_table(const std::vector<std::size_t>& offsets, std::vector<double>& weights) {
+	neighborhoods.clear();
+	neighborhoods.reserve(idx2vertex.size());
+	auto start = neighbours.data();
+	for(auto it = offsets.begin(), next = it + 1; next != offsets.end(); ++it, ++next)
+	  neighborhoods.push_back({start + *it, start + *next, nullptr});
+	nbh_vertices = idx2vertex;
+	nbh_weights.swap(weights);
+	nbh_mass     = mass;
+	nbh_ok       = true;
+      }
+
+      /**
+       * This computes the neighborhoods of all the vertices, and packs
+       * them in a single array. The hop distances are kept, so if the
+       * topology has not changed since the previous computation, only
+       * the kernel is applied again (no breadth-first search), unless
+       * the kernel radius has increased.
+       */
+      template<typename EXECUTOR, typename VALUE_OF_EDGE_DISTANCE>
+      void make_neighborhood_table(EXECUTOR& executor, const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
+	check_index_range();
+	lazy_state.reset();
+
+	auto weights = kernel(voed, max_dist, min_val);
+	unsigned int radius = weights.size() - 1;
+
+	std::vector<std::size_t> offsets;
+	std::vector<index_type>  adjacency;
+	make_adjacency(offsets, adjacency);
+	bool same_topology = nbh_ok && idx2vertex == nbh_vertices && offsets == nbh_offsets && adjacency == nbh_adjacency;
+	nbh_offsets.swap(offsets);
+	nbh_adjacency.swap(adjacency);
+
+	if(same_topology && weights == nbh_weights && mass == nbh_mass)
+	  return;
+
+	if(!(same_topology && hops_ok && radius <= hop_radius)) {
+	  pack_all(executor, hops, hop_offsets,
+		   [this, radius](index_type idx, Visited& visited, std::vector<Hop>& packed) {pack_hops(idx, radius, visited, packed);});
+	  hop_radius = radius;
+	  hops_ok    = true;
+	}
+
+	// This is the reweighting pass. Hops are sorted by increasing distance.
+	offsets.clear();
+	offsets.reserve(idx2vertex.size() + 1);
+	offsets.push_back(0);
+	neighbours.clear();
+	neighbours.reserve(hops.size());
+	for(auto it = hop_offsets.begin(), next = it + 1; next != hop_offsets.end(); ++it, ++next) {
+	  auto first = neighbours.size();
+	  for(auto hit = hops.begin() + *it, hend = hops.begin() + *next; hit != hend && hit->dist <= radius; ++hit)
+	    neighbours.push_back({hit->index, (float)(weights[hit->dist])});
+	  sort_and_truncate(neighbours, first);
+	  offsets.push_back(neighbours.size());
+	}
+
+	finish_neighborhood_table(offsets, weights);
+      }
+
+      static Neighborhood make_neighborhood(const typename Lazy::items_type& items) {
+	return {items->data(), items->data() + items->size(), items};
+      }
+
+      /**
+       * This gets the neighborhood of vertex #idx from the cache, or
+       * computes it. The mutex is not held during the computation, so
+       * that several threads can compute distinct neighborhoods.
+       */
+      Neighborhood lazy_neighborhood(index_type idx) const {
+	auto& l = *lazy_state;
+	std::unique_ptr<Visited> visited;
+	{
+	  std::lock_guard<std::mutex> lock(l.mutex);
+	  if(auto it = l.cache.find(idx); it != l.cache.end()) {
+	    l.lru.splice(l.lru.begin(), l.lru, it->second.second);
+	    return make_neighborhood(it->second.first);
+	  }
+	  if(!l.visited_pool.empty()) {
+	    visited = std::move(l.visited_pool.back());
+	    l.visited_pool.pop_back();
+	  }
+	}
+
+	if(!visited)
+	  visited = std::make_unique<Visited>();
+	auto items = std::make_shared<std::vector<Neighbour>>();
+	pack_neighborhood(idx, nbh_weights, *visited, *items);
+
+	std::lock_guard<std::mutex> lock(l.mutex);
+	l.visited_pool.push_back(std::move(visited));
+	if(auto it = l.cache.find(idx); it != l.cache.end()) { // Another thread has been faster.
+	  l.lru.splice(l.lru.begin(), l.lru, it->second.second);
+	  return make_neighborhood(it->second.first);
+	}
+	l.lru.push_front(idx);
+	l.cache.emplace(idx, std::make_pair(typename Lazy::items_type(items), l.lru.begin()));
+	l.shrink();
+	return make_neighborhood(items);
+      }
+
+      // This gives, for each vertex of the (refilled) table, its index when the neighborhoods have been computed.
+      std::vector<index_type> previous_indices() const {
+	std::vector<index_type> new2old(idx2vertex.size(), no_index);
+	index_type old = 0;
+	for(auto& ref_v : nbh_vertices) {
+	  std::size_t idx;
+	  if(ref_v->get_table_index(stamp, idx))
+	    new2old[idx] = old;
+	  ++old;
+	}
+	return new2old;
+      }
+
+      /**
+       * The table has been refilled, and the current adjacency has
+       * been recorded. Only the neighborhoods that may have changed
+       * are recomputed, the other ones are copied (and their indices
+       * translated). Changes are due to touched and removed vertices,
+       * and to the new ones.
+       */
+      template<typename VALUE_OF_EDGE_DISTANCE>
+      void update_neighborhood_table(const std::vector<index_type>& touched, const std::vector<index_type>& new2old,
+				     const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
+	check_index_range();
+
+	auto nb_old = nbh_vertices.size();
+	auto nb_new = idx2vertex.size();
+
+	std::vector<index_type> old2new(nb_old, no_index);
+	for(index_type idx = 0; idx < nb_new; ++idx)
+	  if(new2old[idx] != no_index)
+	    old2new[new2old[idx]] = idx;
+
+	// Flagged vertices (old indices) are the removed and touched ones.
+	std::vector<char> flagged(nb_old, 0);
+	std::vector<index_type> seeds = touched;
+	for(index_type old = 0; old < nb_old; ++old)
+	  if(old2new[old] == no_index)
+	    flagged[old] = 1;
+	for(auto idx : touched)
+	  if(new2old[idx] != no_index)
+	    flagged[new2old[idx]] = 1;
+	for(index_type idx = 0; idx < nb_new; ++idx)
+	  if(new2old[idx] == no_index)
+	    seeds.push_back(idx);
+
+	// Neighborhoods are symmetrical. A neighborhood is affected
+	// if it contained a flagged vertex in the previous graph, or
+	// if it contains a seed in the current one.
+	std::vector<char> affected(nb_new, 0);
+	for(index_type old = 0; old < nb_old; ++old)
+	  if(auto idx = old2new[old]; idx != no_index)
+	    for(auto& info : neighborhoods[old])
+	      if(flagged[info.index]) {
+		affected[idx] = 1;
+		break;
+	      }
+
+	auto weights = kernel(voed, max_dist, min_val);
+	Visited visited;
+	for(auto idx : seeds)
+	  search_hops(idx, weights.size() - 1, visited,
+		      [&affected](index_type index, unsigned int) {affected[index] = 1;});
+
+	auto old_neighbours     = std::move(neighbours);
+	auto old_neighborhoods  = std::move(neighborhoods);
+	std::vector<std::size_t> offsets;
+	offsets.reserve(nb_new + 1);
+	offsets.push_back(0);
+	neighbours.clear();
+	neighbours.reserve(old_neighbours.size());
+	for(index_type idx = 0; idx < nb_new; ++idx) {
+	  if(affected[idx])
+	    pack_neighborhood(idx, weights, visited, neighbours);
+	  else
+	    for(auto& info : old_neighborhoods[new2old[idx]])
+	      neighbours.push_back({(std::uint32_t)(old2new[info.index]), info.value});
+	  offsets.push_back(neighbours.size());
+	}
+
+	hops_ok = false;
+	finish_neighborhood_table(offsets, weights);
       }
     
       
@@ -207,9 +695,177 @@ namespace vq3 {
        */
       template<typename VALUE_OF_EDGE_DISTANCE>
       void operator()(const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
-	  clear_vertices();
-	  fill_vertices();
-	  make_neighborhood_table(voed, max_dist, min_val);
+	(*this)(1, voed, max_dist, min_val);
+      }
+
+      /**
+       * Updates the vertices and neighbours (typically after a topology change in terms of vertices and/or edges of the graph). The neighborhoods are computed in parallel.
+       * @param exec Either the number of threads, or an executor (see vq3::concept::Executor).
+       */
+      template<typename EXECUTOR, typename VALUE_OF_EDGE_DISTANCE>
+      void operator()(EXECUTOR&& exec, const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
+	clear_vertices();
+	fill_vertices();
+	auto&& executor = vq3::executor::of(exec);
+	make_neighborhood_table(executor, voed, max_dist, min_val);
+      }
+
+      /**
+       * This sets the cutoff mass for the next neighborhood
+       * computations. Each neighborhood is truncated to its most
+       * weighted vertices, whose values sum to mass times the total
+       * value of the neighborhood. With wide kernels, most of the
+       * neighbours have negligible values, so the WTM processing
+       * costs proportional to the effective support of the kernel
+       * rather than to max_dist.
+       * @param mass The cutoff mass, in ]0, 1]. 1 (default) means no truncation.
+       */
+      void cutoff(double mass) {
+	if(!(mass > 0 && mass <= 1))
+	  throw std::runtime_error("vq3::topology::Table::cutoff : the mass must be in ]0, 1].");
+	this->mass = mass;
+      }
+
+      /**
+       * Updates the vertices, and switches to the lazy mode: the
+       * neighborhoods are not computed here, but when they are
+       * accessed (operator[]). They are kept in a bounded cache, the
+       * least recently used ones being evicted. This is relevant for
+       * large graphs where only a few vertices win samples during an
+       * epoch. operator[] is thread-safe in this mode. The cache is
+       * cleared if the graph or the kernel have changed since the
+       * previous call. Calling (*this)(voed, max_dist, min_val)
+       * switches back to the computation of the whole table. The
+       * incremental updates (update and the touched vertices version
+       * of operator()) stay in lazy mode, they only invalidate the
+       * cache if needed.
+       * @param capacity The maximal number of cached neighborhoods. 0 means "no limit".
+       */
+      template<typename VALUE_OF_EDGE_DISTANCE>
+      void lazy(std::size_t capacity, const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
+	clear_vertices();
+	fill_vertices();
+	check_index_range();
+
+	auto weights = kernel(voed, max_dist, min_val);
+	std::vector<std::size_t> offsets;
+	std::vector<index_type>  adjacency;
+	make_adjacency(offsets, adjacency);
+	bool unchanged = lazy_state && idx2vertex == nbh_vertices && offsets == nbh_offsets && adjacency == nbh_adjacency && weights == nbh_weights && mass == nbh_mass;
+	nbh_offsets.swap(offsets);
+	nbh_adjacency.swap(adjacency);
+	nbh_weights.swap(weights);
+	nbh_mass = mass;
+	nbh_vertices = idx2vertex;
+
+	// The whole table is not maintained in lazy mode.
+	nbh_ok  = false;
+	hops_ok = false;
+	std::vector<Neighbour>().swap(neighbours);
+	std::vector<Neighborhood>().swap(neighborhoods);
+	std::vector<Hop>().swap(hops);
+
+	if(unchanged) {
+	  lazy_state->capacity = capacity;
+	  lazy_state->shrink();
+	}
+	else
+	  lazy_state = std::make_unique<Lazy>(capacity);
+      }
+
+      /**
+       * Updates the vertices and neighbours, as (*this)(voed, max_dist,
+       * min_val) does, but only the neighborhoods that may have
+       * changed since the last neighborhood computation are
+       * recomputed. The whole table is recomputed if the kernel
+       * given by the arguments differs from the one of that
+       * computation (the hop distances are reused when they are
+       * still valid), or if a cutoff mass is set or has been
+       * changed since (see cutoff).
+       * @param touched_begin, touched_end The vertices (references) whose edges have changed, i.e. the extremities of the added and removed edges. Removed and added vertices are detected, they do not need to be in that collection.
+       */
+      template<typename VERTEX_IT, typename VALUE_OF_EDGE_DISTANCE>
+      void operator()(const VERTEX_IT& touched_begin, const VERTEX_IT& touched_end,
+		      const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
+	if(lazy_state) {
+	  lazy(lazy_state->capacity, voed, max_dist, min_val);
+	  return;
+	}
+	clear_vertices();
+	fill_vertices();
+	if(!nbh_ok || mass < 1 || mass != nbh_mass || kernel(voed, max_dist, min_val) != nbh_weights) {
+	  (*this)(voed, max_dist, min_val);
+	  return;
+	}
+	make_adjacency(nbh_offsets, nbh_adjacency);
+
+	std::vector<index_type> touched;
+	for(auto it = touched_begin; it != touched_end; ++it) {
+	  std::size_t idx;
+	  if(*it != nullptr && (*it)->get_table_index(stamp, idx))
+	    touched.push_back(idx);
+	}
+	update_neighborhood_table(touched, previous_indices(), voed, max_dist, min_val);
+      }
+
+      /**
+       * Updates the vertices and neighbours, as (*this)(voed, max_dist,
+       * min_val) does, but only the neighborhoods that may have
+       * changed since the last neighborhood computation are
+       * recomputed. The touched vertices are detected, by comparing
+       * the edges of each vertex with the ones it had at the time of
+       * that computation. This costs a linear pass on the edges, which
+       * is much cheaper than the computation of all the neighborhoods
+       * when the graph changes only locally (e.g. GNG-T). The whole
+       * table is recomputed if the kernel given by the arguments
+       * differs from the one of the last computation (the hop
+       * distances are reused when they are still valid), or if a
+       * cutoff mass is set or has been changed since (see cutoff).
+       */
+      template<typename VALUE_OF_EDGE_DISTANCE>
+      void update(const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
+	if(lazy_state) {
+	  lazy(lazy_state->capacity, voed, max_dist, min_val);
+	  return;
+	}
+	clear_vertices();
+	fill_vertices();
+	if(!nbh_ok || mass < 1 || mass != nbh_mass || kernel(voed, max_dist, min_val) != nbh_weights) {
+	  (*this)(voed, max_dist, min_val);
+	  return;
+	}
+
+	auto new2old = previous_indices();
+	std::vector<std::size_t> offsets;
+	std::vector<index_type>  adjacency;
+	make_adjacency(offsets, adjacency);
+
+	std::vector<index_type> touched;
+	std::vector<index_type> current;
+	for(index_type idx = 0; idx < idx2vertex.size(); ++idx) {
+	  auto old = new2old[idx];
+	  if(old == no_index)
+	    continue; // New vertices are handled anyway.
+
+	  bool changed = false;
+	  current.clear();
+	  for(auto it = adjacency.begin() + offsets[idx], end = adjacency.begin() + offsets[idx + 1]; it != end && !changed; ++it)
+	    if(auto other_old = new2old[*it]; other_old == no_index)
+	      changed = true;
+	    else
+	      current.push_back(other_old);
+	  if(!changed) {
+	    std::sort(current.begin(), current.end());
+	    changed = !std::equal(current.begin(), current.end(),
+				  nbh_adjacency.begin() + nbh_offsets[old], nbh_adjacency.begin() + nbh_offsets[old + 1]);
+	  }
+	  if(changed)
+	    touched.push_back(idx);
+	}
+
+	nbh_offsets.swap(offsets);
+	nbh_adjacency.swap(adjacency);
+	update_neighborhood_table(touched, new2old, voed, max_dist, min_val);
       }
 
     
@@ -247,34 +903,44 @@ namespace vq3 {
       const typename graph_type::ref_vertex& operator()(index_type idx) const {return idx2vertex[idx];}
       
       /**
-       * @return the index of the vertex (reference). Complexiy is logarithmic.
+       * @return the index of the vertex (reference). Complexiy is constant (see the class documentation).
        */
       const index_type operator()(const typename graph_type::ref_vertex& ref_v) const {
-	auto pt = ref_v.get();
-	auto it = vertex2idx.find(pt);
-	if(it == vertex2idx.end()) {
-	  std::ostringstream ostr;
-	  ostr << "vq3::topology::Table::operator(" << pt << ") : bad vertex reference";
-	  throw std::runtime_error(ostr.str());
-	}
-	return it->second;
+	std::size_t idx;
+	if(ref_v != nullptr && ref_v->get_table_index(stamp, idx))
+	  return idx;
+
+	// The vertex index may have been overwritten by another table.
+	if(auto found = index_of_vertex.find(reinterpret_cast<std::uintptr_t>(ref_v.get())); found != nullptr)
+	  return *found;
+	std::ostringstream ostr;
+	ostr << "vq3::topology::Table::operator(" << ref_v.get() << ") : bad vertex reference";
+	throw std::runtime_error(ostr.str());
       }
 
       /**
-       * @returns the neighborhood of vertex #idx. (*this)(voed, max_dist, min_val) should be called first in order to update the neigborhood of all the vertices.
+       * @return The average number of items in the neighborhoods, or 0 if it is not known without computing them (lazy mode, or no neighborhood computed yet).
        */
-      auto& operator[](index_type idx) const {
-	auto ref_v = idx2vertex[idx];
-	auto it = neighborhood_table.find(ref_v);
-	return it->second;
+      double mean_neighborhood_size() const {
+	if(lazy_state || !nbh_ok || neighborhoods.empty())
+	  return 0;
+	return neighbours.size() / (double)(neighborhoods.size());
       }
 
       /**
-       * @returns the neighborhood of vertex ref_v. (*this)(voed, max_dist, min_val) should be called first in order to update the neigborhood of all the vertices.
+       * @returns the neighborhood of vertex #idx, as a contiguous range of Neighbour (index, value) items. (*this)(voed, max_dist, min_val) should be called first in order to update the neigborhood of all the vertices (or lazy, see lazy).
        */
-      auto& operator[](const typename graph_type::ref_vertex& ref_v) const {
-	auto it = neighborhood_table.find(ref_v);
-	return it->second;
+      Neighborhood operator[](index_type idx) const {
+	if(lazy_state)
+	  return lazy_neighborhood(idx);
+	return neighborhoods[idx];
+      }
+
+      /**
+       * @returns the neighborhood of vertex ref_v, as a contiguous range of Neighbour (index, value) items. (*this)(voed, max_dist, min_val) should be called first in order to update the neigborhood of all the vertices (or lazy, see lazy).
+       */
+      Neighborhood operator[](const typename graph_type::ref_vertex& ref_v) const {
+	return (*this)[(*this)(ref_v)];
       }
     };
 
@@ -282,6 +948,290 @@ namespace vq3 {
     auto table(GRAPH& g) {
       return Table<GRAPH>(g);
     }
+
+    /**
+     * This is the kind of regular grid handled by vq3::topology::Grid.
+     */
+    enum class grid_kind : char {
+      square,    //!< 4-connectivity, as built by vq3::utils::make_grid.
+      toroidal,  //!< 4-connectivity, with wrapping borders.
+      hexagonal  //!< 6-connectivity, odd rows are shifted right by half a cell.
+    };
+    
+    /**
+     * This is a topology table dedicated to regular grids, whose
+     * vertices are decorated with vq3::decorator::grid_pos (each
+     * vertex having a distinct position). It can be used wherever
+     * vq3::topology::Table is.
+     *
+     * The neighborhoods are not computed by breadth-first searches
+     * on the graph, nor stored. They are generated on the fly from
+     * the grid positions: the hop distance between two positions is
+     * known analytically for the grid kind, and the kernel values
+     * for each distance are computed once, when (*this)(voed,
+     * max_dist, min_val) is called. The graph edges are ignored, the
+     * memory used for the neighborhoods only depends on the kernel
+     * radius.
+     *
+     * As with vq3::topology::Table, the first element of a
+     * neighborhood is the origin vertex.
+     */
+    template<typename GRAPH>
+    class Grid {
+    public:
+      using graph_type      = GRAPH;
+      using index_type      = typename std::vector<typename GRAPH::ref_vertex>::size_type;
+
+      /**
+       * This is the neighborhood information provided when a neighborhood is iterated.
+       */
+      struct Neighbour {
+	index_type index;
+	float      value;
+      };
+
+    private:
+
+      struct Offset {
+	int      dw, dh;
+	unsigned int dist;
+      };
+
+      static constexpr index_type no_index = std::numeric_limits<index_type>::max();
+
+      grid_kind                                    kind;
+      std::vector<typename graph_type::ref_vertex> idx2vertex;
+      std::size_t                                  stamp  = 0;
+      int                                          width  = 0;
+      int                                          height = 0;
+      std::vector<index_type>                      cells;       // cells[h*width + w] is the index of the vertex at (w, h), or no_index.
+      std::vector<float>                           weights;     // weights[d] is the kernel value for a hop distance d.
+      std::vector<Offset>                          offsets[2];  // The offsets in the neighborhood, for even and odd rows, sorted by increasing distance.
+
+      void fill_vertices() {
+	idx2vertex.clear();
+	stamp  = new_table_stamp();
+	width  = 0;
+	height = 0;
+	g.foreach_vertex([this](const typename graph_type::ref_vertex& ref_v) {
+	    auto idx = this->idx2vertex.size();
+	    this->idx2vertex.push_back(ref_v);
+	    ref_v->set_table_index(this->stamp, idx);
+	    auto& pos = (*ref_v)().vq3_gridpos;
+	    this->width  = std::max(this->width,  (int)(pos.first)  + 1);
+	    this->height = std::max(this->height, (int)(pos.second) + 1);
+	  });
+
+	cells.assign(width*height, no_index);
+	index_type idx = 0;
+	for(auto& ref_v : idx2vertex) {
+	  auto& pos = (*ref_v)().vq3_gridpos;
+	  auto& cell = cells[pos.second*width + pos.first];
+	  if(cell != no_index)
+	    throw std::runtime_error("vq3::topology::Grid : several vertices share the same grid position.");
+	  cell = idx++;
+	}
+      }
+
+      // This is the hop distance from (0, parity) to (dw, parity + dh).
+      unsigned int hops(int dw, int dh, int parity) const {
+	if(kind != grid_kind::hexagonal)
+	  return std::abs(dw) + std::abs(dh);
+	// Cube coordinates of odd-r offset coordinates.
+	int row = parity + dh;
+	int x0  = - (parity - (parity & 1))/2;
+	int x   = dw - (row - (row & 1))/2;
+	int dx  = x - x0;
+	int dz  = dh;
+	int dy  = -dx - dz;
+	return std::max(std::abs(dx), std::max(std::abs(dy), std::abs(dz)));
+      }
+
+      void make_offsets() {
+	int radius = (int)(weights.size()) - 1;
+	for(int parity = 0; parity < 2; ++parity) {
+	  auto& offs = offsets[parity];
+	  offs.clear();
+	  int wmin = -radius - 1, wmax = radius + 1;
+	  int hmin = -radius,     hmax = radius;
+	  if(kind == grid_kind::toroidal) {
+	    // Each cell of the torus is considered once, at its shortest offset.
+	    wmin = std::max(wmin, -(width  - 1)/2); wmax = std::min(wmax, width/2);
+	    hmin = std::max(hmin, -(height - 1)/2); hmax = std::min(hmax, height/2);
+	  }
+	  for(int dh = hmin; dh <= hmax; ++dh)
+	    for(int dw = wmin; dw <= wmax; ++dw)
+	      if(auto d = hops(dw, dh, parity); (int)d <= radius)
+		offs.push_back({dw, dh, d});
+	  std::stable_sort(offs.begin(), offs.end(), [](const Offset& a, const Offset& b) {return a.dist < b.dist;});
+	}
+      }
+      
+    public:
+
+      /**
+       * This is a neighborhood, generated on the fly when it is iterated.
+       */
+      class Neighborhood {
+      private:
+
+	const Grid*   grid   = nullptr;
+	const Offset* first  = nullptr;
+	const Offset* last   = nullptr;
+	int           w      = 0;
+	int           h      = 0;
+
+      public:
+
+	class iterator {
+	private:
+	  
+	  const Neighborhood* n   = nullptr;
+	  const Offset*       it  = nullptr;
+	  Neighbour           current;
+
+	  // This skips the offsets that are outside the grid, or at empty positions.
+	  void settle() {
+	    auto& grid = *(n->grid);
+	    for(; it != n->last; ++it) {
+	      int ww = n->w + it->dw;
+	      int hh = n->h + it->dh;
+	      if(grid.kind == grid_kind::toroidal) {
+		ww = (ww + grid.width)  % grid.width;
+		hh = (hh + grid.height) % grid.height;
+	      }
+	      else if(ww < 0 || ww >= grid.width || hh < 0 || hh >= grid.height)
+		continue;
+	      if(auto idx = grid.cells[hh*grid.width + ww]; idx != no_index) {
+		current = {idx, grid.weights[it->dist]};
+		return;
+	      }
+	    }
+	  }
+
+	public:
+	  
+	  iterator(const Neighborhood* n, const Offset* it) : n(n), it(it), current() {settle();}
+	  iterator()                           = default;
+	  iterator(const iterator&)            = default;
+	  iterator& operator=(const iterator&) = default;
+	  
+	  const Neighbour& operator*()  const {return current;}
+	  const Neighbour* operator->() const {return &current;}
+	  iterator& operator++() {++it; settle(); return *this;}
+	  bool operator==(const iterator& other) const {return it == other.it;}
+	  bool operator!=(const iterator& other) const {return it != other.it;}
+	};
+
+	Neighborhood(const Grid* grid, const std::vector<Offset>& offs, int w, int h)
+	  : grid(grid), first(offs.data()), last(offs.data() + offs.size()), w(w), h(h) {}
+	Neighborhood()                               = default;
+	Neighborhood(const Neighborhood&)            = default;
+	Neighborhood& operator=(const Neighborhood&) = default;
+
+	iterator begin() const {return iterator(this, first);}
+	iterator end()   const {return iterator(this, last);}
+      };
+      
+      graph_type& g;
+
+      Grid(graph_type& g, grid_kind kind) : kind(kind), g(g) {}
+      Grid()                       = delete;
+      Grid(const Grid&)            = delete;
+      Grid(Grid&&)                 = default;
+      Grid& operator=(const Grid&) = delete;
+      Grid& operator=(Grid&&)      = delete;
+
+      /**
+       * @return the number of vertices in the table.
+       */
+      const index_type size() const {return idx2vertex.size();}
+
+      /**
+       * Updates the vertices only (typically after the adding or removal of vertices in the graph).
+       */
+      void operator()() {
+	fill_vertices();
+	make_offsets();
+      }
+      
+      /**
+       * Updates the vertices and the kernel. No neighborhood is computed here.
+       * @param voed A function providing a value (double >= 0) according to the number of edges (unsigned int) separating a vertex in the neighborhood from the central vertex.
+       * @param max_dist The maximal distance considered. 0 means "no limit".
+       * @param min_val if voed(dist) < min_val, the node is not included in the neighborhood.
+       */
+      template<typename VALUE_OF_EDGE_DISTANCE>
+      void operator()(const VALUE_OF_EDGE_DISTANCE& voed, unsigned int max_dist, double min_val) {
+	fill_vertices();
+	unsigned int diameter = width + height;
+	if(max_dist == 0 || max_dist > diameter)
+	  max_dist = diameter;
+	weights.clear();
+	weights.push_back((float)(voed(0)));
+	for(unsigned int d = 1; d <= max_dist; ++d) {
+	  double val = voed(d);
+	  if(val <= min_val)
+	    break;
+	  weights.push_back((float)val);
+	}
+	make_offsets();
+      }
+
+      /**
+       * @return the vertex (reference) whose index is idx. Complexiy is contant.
+       */
+      const typename graph_type::ref_vertex& operator()(index_type idx) const {return idx2vertex[idx];}
+      
+      /**
+       * @return the index of the vertex (reference). Complexiy is constant (see vq3::topology::Table).
+       */
+      const index_type operator()(const typename graph_type::ref_vertex& ref_v) const {
+	std::size_t idx;
+	if(ref_v != nullptr && ref_v->get_table_index(stamp, idx))
+	  return idx;
+	if(ref_v != nullptr) {
+	  auto& pos = (*ref_v)().vq3_gridpos;
+	  if((int)(pos.first) < width && (int)(pos.second) < height)
+	    if(auto idx = cells[pos.second*width + pos.first]; idx != no_index && idx2vertex[idx] == ref_v)
+	      return idx;
+	}
+	std::ostringstream ostr;
+	ostr << "vq3::topology::Grid::operator(" << ref_v.get() << ") : bad vertex reference";
+	throw std::runtime_error(ostr.str());
+      }
+
+      /**
+       * @return An upper bound of the number of items in the neighborhoods (vertices on the borders or next to empty positions have less), or 0 if the kernel is not set.
+       */
+      double mean_neighborhood_size() const {
+	return offsets[0].size();
+      }
+
+      /**
+       * @returns the neighborhood of vertex #idx, i.e. an iterable collection of Neighbour (index, value) items. (*this)(voed, max_dist, min_val) should be called first in order to set the kernel.
+       */
+      Neighborhood operator[](index_type idx) const {
+	auto& pos = (*(idx2vertex[idx]))().vq3_gridpos;
+	return Neighborhood(this, offsets[pos.second & 1], pos.first, pos.second);
+      }
+
+      /**
+       * @returns the neighborhood of vertex ref_v, i.e. an iterable collection of Neighbour (index, value) items. (*this)(voed, max_dist, min_val) should be called first in order to set the kernel.
+       */
+      Neighborhood operator[](const typename graph_type::ref_vertex& ref_v) const {
+	return (*this)[(*this)(ref_v)];
+      }
+    };
+
+    /**
+     * @param g A graph whose vertices are decorated with vq3::decorator::grid_pos.
+     * @param kind The kind of grid.
+     */
+    template<typename GRAPH>
+    auto grid(GRAPH& g, grid_kind kind = grid_kind::square) {
+      return Grid<GRAPH>(g, kind);
+    }
     
   }
   
@@ -27,6 +27,8 @@
 #pragma once
 
 #include <limits>
+#include <cstdint>
+#include <cstddef>
 #include <utility>
 #include <vector>
 #include <list>
@@ -107,6 +109,92 @@ namespace vq3 {
     };
 
 
+    /**
+     * This is an open addressing hash table, mapping 64 bits keys to
+     * 32 bits values. The key ~0 is reserved. Clearing keeps the
+     * memory, so that the table can be reused.
+     */
+    class FlatMap {
+    private:
+
+      static constexpr std::uint64_t empty = std::numeric_limits<std::uint64_t>::max();
+
+      std::vector<std::pair<std::uint64_t, std::uint32_t>> slots;
+      std::size_t                                          count = 0;
+
+      static std::uint64_t hash(std::uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+      }
+
+      std::size_t slot_of(std::uint64_t key) const {
+	std::size_t mask = slots.size() - 1;
+	std::size_t pos  = hash(key) & mask;
+	while(slots[pos].first != empty && slots[pos].first != key)
+	  pos = (pos + 1) & mask;
+	return pos;
+      }
+
+      void rehash(std::size_t capacity) {
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> old(capacity, {empty, 0});
+	std::swap(old, slots);
+	for(auto& kv : old)
+	  if(kv.first != empty)
+	    slots[slot_of(kv.first)] = kv;
+      }
+
+    public:
+
+      FlatMap() : slots(16, {empty, 0}), count(0) {}
+
+      std::size_t size() const {return count;}
+
+      void clear() {
+	if(count != 0)
+	  std::fill(slots.begin(), slots.end(), std::make_pair(empty, std::uint32_t(0)));
+	count = 0;
+      }
+
+      /** This reserves room for nb elements. */
+      void reserve(std::size_t nb) {
+	std::size_t capacity = slots.size();
+	while(capacity < 2*nb) capacity *= 2;
+	if(capacity != slots.size())
+	  rehash(capacity);
+      }
+
+      /** @return false if the key was already there (the value is unchanged then). */
+      bool insert(std::uint64_t key, std::uint32_t value) {
+	if(2*(count + 1) > slots.size())
+	  rehash(2*slots.size());
+	auto& slot = slots[slot_of(key)];
+	if(slot.first == key)
+	  return false;
+	slot = {key, value};
+	++count;
+	return true;
+      }
+
+      /** @return A pointer to the value, nullptr if the key is not found. */
+      const std::uint32_t* find(std::uint64_t key) const {
+	auto& slot = slots[slot_of(key)];
+	if(slot.first == empty)
+	  return nullptr;
+	return &(slot.second);
+      }
+
+      template<typename FUN>
+      void foreach(const FUN& fun) const {
+	for(auto& kv : slots)
+	  if(kv.first != empty)
+	    fun(kv.first, kv.second);
+      }
+    };
+
     /**
      * @param g The graph
      * @param value_of value_of(ref_vertex) gives the value to be stored in the map.
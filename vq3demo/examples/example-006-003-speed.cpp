@@ -195,7 +195,8 @@ int main(int argc, char* argv[]) {
 
     // Step
 
-    topology([](unsigned int edge_distance) {return edge_distance == 0 ? 1.0 : 0.1;}, 1, 0);
+    // Only the neighborhoods affected by the last GNG-T step are recomputed.
+    topology.update([](unsigned int edge_distance) {return edge_distance == 0 ? 1.0 : 0.1;}, 1, 0);
     for(int wta_step = 0; wta_step < 2; ++wta_step)
       wtm.process<epoch_wtm>(nb_threads,
 			     S.begin(), S.end(),